@@ -0,0 +1,35 @@
+#ifndef _BITS_H_
+#define _BITS_H_
+
+#include "types.h"
+
+extern const u8 bits_count8[256];
+extern const u8 bits_nth4[16][4];
+
+// number of set bits
+static inline u8 bits_count(u16 x) {
+	return bits_count8[x & 0xff] + bits_count8[x >> 8];
+}
+
+// position of the k-th set bit, counting from bit 0 (k < bits_count(x)).
+// halves the search twice by masks rather than branches, then finishes
+// in a nibble table.
+static inline u8 bits_nth(u16 x, u8 k) {
+	u8 n, m, s;
+
+	n = bits_count8[x & 0xff];
+	m = -(k >= n);
+	k -= n & m;
+	s = 8 & m;
+	x >>= s;
+
+	n = bits_count8[x & 0xf];
+	m = -(k >= n);
+	k -= n & m;
+	s += 4 & m;
+	x >>= 4 & m;
+
+	return s + bits_nth4[x & 0xf][k & 3];
+}
+
+#endif
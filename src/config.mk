@@ -63,6 +63,18 @@ TARGET = $(THIS).elf
 # List of C source files.
 CSRCS = \
        ../src/main.c    \
+       ../src/bits.c    \
+       ../src/dac.c    \
+       ../src/extclock.c    \
+       ../src/frame.c    \
+       ../src/gate.c    \
+       ../src/hold.c    \
+       ../src/journal.c    \
+       ../src/latency.c    \
+       ../src/queue.c    \
+       ../src/random.c    \
+       ../src/store.c    \
+       ../src/tempo.c    \
        ../libavr32/src/adc.c     \
        ../libavr32/src/events.c     \
        ../libavr32/src/i2c.c     \
@@ -82,6 +94,7 @@ CSRCS = \
        avr32/drivers/flashc/flashc.c                      \
        avr32/drivers/gpio/gpio.c                          \
        avr32/drivers/intc/intc.c                          \
+       avr32/drivers/pdca/pdca.c                          \
        avr32/drivers/pm/pm.c                              \
        avr32/drivers/pm/pm_conf_clocks.c                  \
        avr32/drivers/pm/power_clocks_lib.c                \
@@ -118,6 +131,7 @@ INC_PATH = \
        avr32/drivers/flashc                               \
        avr32/drivers/gpio                                 \
        avr32/drivers/intc                                 \
+       avr32/drivers/pdca                                 \
        avr32/drivers/pm                                   \
        avr32/drivers/spi                                  \
        avr32/drivers/tc                                   \
@@ -0,0 +1,79 @@
+// non-blocking dac output.
+//
+// both channel words and a latch command are queued to the spi by the
+// pdca, so the caller returns as soon as the buffer is handed over. the
+// dac input registers are written first and then updated together, so cv
+// a and b change on the same sclk edge.
+//
+// the spi runs in variable peripheral select mode: every transmit word
+// carries its own chip select, and LASTXFER raises it at the end of each
+// 3-byte dac frame.
+
+#include "compiler.h"
+#include "pdca.h"
+#include "spi.h"
+
+#include "conf_board.h"
+#include "dac.h"
+
+// dac commands: high nibble command, low nibble channel address
+#define DAC_WRITE_A 0x11	// write input register A
+#define DAC_WRITE_B 0x18	// write input register B
+#define DAC_UPDATE_AB 0x29	// update A and B from input registers
+
+#define DAC_WORDS 9
+#define DAC_PCS ((~(1 << DAC_SPI_NPCS) & 0xf) << AVR32_SPI_TDR_PCS_OFFSET)
+#define DAC_LAST (1 << AVR32_SPI_TDR_LASTXFER_OFFSET)
+
+// two buffers: one may be in flight while the next is queued as reload
+static u32 dac_buf[2][DAC_WORDS];
+static u8 dac_next;
+
+u32 dac_overruns;
+
+
+static void dac_frame(u32 *d, u8 cmd, u16 value) {
+	d[0] = DAC_PCS | cmd;
+	d[1] = DAC_PCS | ((value >> 4) & 0xff);
+	d[2] = DAC_PCS | DAC_LAST | ((value << 4) & 0xff);
+}
+
+void init_dac(void) {
+	static const pdca_channel_options_t opt = {
+		.addr = NULL,
+		.size = 0,
+		.r_addr = NULL,
+		.r_size = 0,
+		.pid = AVR32_PDCA_PID_SPI_TX,
+		.transfer_size = PDCA_TRANSFER_SIZE_WORD
+	};
+
+	spi_disable(DAC_SPI);
+	spi_selectionMode(DAC_SPI, 1, 0, 0);
+	spi_enable(DAC_SPI);
+
+	pdca_init_channel(DAC_PDCA_CHANNEL, &opt);
+	pdca_enable(DAC_PDCA_CHANNEL);
+}
+
+void dac_set(u16 a, u16 b) {
+	u32 *d;
+
+	// both the transfer and its reload are still pending: keep the old value
+	if(pdca_get_load_size(DAC_PDCA_CHANNEL) && pdca_get_reload_size(DAC_PDCA_CHANNEL)) {
+		dac_overruns++;
+		return;
+	}
+
+	d = dac_buf[dac_next];
+	dac_frame(d, DAC_WRITE_A, a);
+	dac_frame(d + 3, DAC_WRITE_B, b);
+	dac_frame(d + 6, DAC_UPDATE_AB, 0);
+
+	if(pdca_get_load_size(DAC_PDCA_CHANNEL))
+		pdca_reload_channel(DAC_PDCA_CHANNEL, d, DAC_WORDS);
+	else
+		pdca_load_channel(DAC_PDCA_CHANNEL, d, DAC_WORDS);
+
+	dac_next ^= 1;
+}
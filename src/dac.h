@@ -0,0 +1,14 @@
+#ifndef _DAC_H_
+#define _DAC_H_
+
+#include "types.h"
+
+// pdca channel feeding the spi transmit register
+#define DAC_PDCA_CHANNEL 0
+
+extern u32 dac_overruns;
+
+extern void init_dac(void);
+extern void dac_set(u16 a, u16 b);
+
+#endif
@@ -0,0 +1,128 @@
+// external clock tracker.
+//
+// rising edges are timestamped with the cycle counter and the period is
+// smoothed, rejecting single outliers and following real tempo changes
+// after two in a row. to multiply or divide, every output pulse that
+// coincides with an input edge restarts the tempo engine on that edge, and
+// the pulses in between are predicted from the tracked period. prediction
+// stops after one input period's worth of phases, so a stopped or slowing
+// master never gets overrun.
+
+#include "compiler.h"
+#include "cycle_counter.h"
+#include "print_funcs.h"
+
+#include "conf_board.h"
+#include "extclock.h"
+#include "tempo.h"
+
+// outlier if more than 1/4 away from the estimate
+#define EXT_TOLERANCE 2
+// filter weight for new periods, as a shift
+#define EXT_SMOOTH 2
+
+u8 extclock_mul = 1, extclock_div = 1;
+
+static u32 last, period, edges;
+static u8 outliers;
+static volatile u8 owed;
+
+// deviation of each measured period from the estimate, cycles
+static u32 jitter_n, jitter_max;
+static u64 jitter_sum;
+
+
+void extclock_ratio(u8 mul, u8 div) {
+	irqflags_t flags = cpu_irq_save();
+
+	extclock_mul = mul ? mul : 1;
+	extclock_div = div ? div : 1;
+	owed = 0;
+	edges = 0;
+
+	cpu_irq_restore(flags);
+}
+
+static void track(u32 now) {
+	u32 m, d;
+
+	m = now - last;
+	last = now;
+
+	if(edges++ == 0)
+		return;
+
+	if(period == 0) {
+		period = m;
+		return;
+	}
+
+	d = m > period ? m - period : period - m;
+	if(d > period >> EXT_TOLERANCE) {
+		// a second outlier in a row is a new tempo
+		if(++outliers > 1) {
+			period = m;
+			outliers = 0;
+		}
+		return;
+	}
+	outliers = 0;
+
+	jitter_n++;
+	jitter_sum += d;
+	if(d > jitter_max)
+		jitter_max = d;
+
+	period = period - (period >> EXT_SMOOTH) + (m >> EXT_SMOOTH);
+}
+
+// rising input edge at cycle count now. returns 1 if an output pulse
+// should start on this edge.
+u8 extclock_edge(u32 now) {
+	u8 start;
+	irqflags_t flags;
+
+	track(now);
+
+	if(extclock_mul == 1 && extclock_div == 1)
+		return 1;
+	if(period == 0)
+		return 0;
+
+	flags = cpu_irq_save();
+
+	start = (edges - 1) % extclock_div == 0;
+	if(start) {
+		// output period is period * div / mul, two phases each
+		tempo_set(((u64)period * extclock_div << 16) / (extclock_mul * 2));
+		tempo_sync();
+		owed = extclock_mul * 2 - 1;
+	}
+
+	cpu_irq_restore(flags);
+
+	return start;
+}
+
+// tempo edge while on external clock: 1 if a predicted phase is due
+u8 extclock_predict(void) {
+	if(owed == 0)
+		return 0;
+	owed--;
+	return 1;
+}
+
+void extclock_print_stats(void) {
+	print_dbg("\r\next clock x");
+	print_dbg_ulong(extclock_mul);
+	print_dbg("/");
+	print_dbg_ulong(extclock_div);
+	print_dbg(" period (us) ");
+	print_dbg_ulong(cpu_cy_2_us(period, FMCK_HZ));
+	print_dbg(" jitter (us) avg ");
+	print_dbg_ulong(jitter_n ? cpu_cy_2_us(jitter_sum / jitter_n, FMCK_HZ) : 0);
+	print_dbg(" max ");
+	print_dbg_ulong(cpu_cy_2_us(jitter_max, FMCK_HZ));
+
+	jitter_n = jitter_sum = jitter_max = 0;
+}
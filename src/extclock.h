@@ -0,0 +1,13 @@
+#ifndef _EXTCLOCK_H_
+#define _EXTCLOCK_H_
+
+#include "types.h"
+
+extern u8 extclock_mul, extclock_div;
+
+extern void extclock_ratio(u8 mul, u8 div);
+extern u8 extclock_edge(u32 now);
+extern u8 extclock_predict(void);
+extern void extclock_print_stats(void);
+
+#endif
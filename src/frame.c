@@ -0,0 +1,174 @@
+// led frame output.
+//
+// the frame is double buffered: the redraw works in monomeLedBuffer and a
+// shadow holds the leds last handed to the grid, and only what differs
+// from it is sent. for each 8x8 quadrant the changed leds are sent as
+// whichever mext message costs fewest bytes: single led levels, level
+// rows or a level map. non-varibright grids get their changed quadrants
+// through the libavr32 map refresh.
+
+#include <string.h>
+
+// asf
+#include "compiler.h"
+#include "cycle_counter.h"
+#include "print_funcs.h"
+
+// skeleton
+#include "ftdi.h"
+#include "monome.h"
+
+// this
+#include "conf_board.h"
+#include "bits.h"
+#include "frame.h"
+
+#define MEXT_LEVEL_SET 0x18
+#define MEXT_LEVEL_MAP 0x1a
+#define MEXT_LEVEL_ROW 0x1b
+
+// message sizes including the header
+#define SET_BYTES 4
+#define ROW_BYTES 7
+#define MAP_BYTES 35
+#define MONO_MAP_BYTES 11
+
+u32 frame_bytes;
+u32 frame_bps;
+u32 frame_send_cy;
+u32 frame_send_max;
+u8 frame_pending;
+u32 frame_held;
+
+static u8 shadow[128];
+static u8 shadow_valid;
+static u8 quadrants, vari;
+
+// two level maps is the most one frame can cost
+static u8 tx[2 * MAP_BYTES];
+
+static u32 window_bytes, window_start, window_max;
+
+
+// new device: its leds are unknown, so the next frame is sent in full
+void frame_reset(u8 size_x, u8 v) {
+	quadrants = size_x > 8 ? 2 : 1;
+	vari = v;
+	shadow_valid = 0;
+	frame_pending = 0;
+}
+
+void frame_send(void) {
+	u8 q, x, y, k, n, *d;
+	u8 changed[8];
+	u16 cost;
+	u32 now, t;
+
+	// the last frame is still going out of tx. the shadow still holds
+	// what the grid shows, so the next call sends everything drawn since
+	if(ftdi_tx_busy()) {
+		frame_pending = 1;
+		frame_held++;
+		return;
+	}
+	frame_pending = 0;
+
+	n = 0;
+
+	for(q=0;q<quadrants;q++) {
+		// changed leds per row, and what sending them row by row costs
+		cost = 0;
+		for(y=0;y<8;y++) {
+			d = monomeLedBuffer + y*16 + q*8;
+			changed[y] = 0;
+			for(x=0;x<8;x++)
+				if(!shadow_valid || d[x] != shadow[y*16 + q*8 + x])
+					changed[y] |= 1<<x;
+
+			k = bits_count(changed[y]);
+			if(k == 1) cost += SET_BYTES;
+			else if(k) cost += ROW_BYTES;
+		}
+
+		if(cost == 0)
+			continue;
+
+		if(!vari) {
+			monome_set_quadrant_flag(q);
+			frame_bytes += MONO_MAP_BYTES;
+			window_bytes += MONO_MAP_BYTES;
+		}
+		else if(cost >= MAP_BYTES) {
+			tx[n++] = MEXT_LEVEL_MAP;
+			tx[n++] = q*8;
+			tx[n++] = 0;
+			for(y=0;y<8;y++) {
+				d = monomeLedBuffer + y*16 + q*8;
+				for(x=0;x<8;x+=2)
+					tx[n++] = (d[x] << 4) | d[x+1];
+			}
+		}
+		else {
+			for(y=0;y<8;y++) {
+				d = monomeLedBuffer + y*16 + q*8;
+				k = bits_count(changed[y]);
+				if(k == 1) {
+					x = bits_nth(changed[y], 0);
+					tx[n++] = MEXT_LEVEL_SET;
+					tx[n++] = q*8 + x;
+					tx[n++] = y;
+					tx[n++] = d[x];
+				}
+				else if(k) {
+					tx[n++] = MEXT_LEVEL_ROW;
+					tx[n++] = q*8;
+					tx[n++] = y;
+					for(x=0;x<8;x+=2)
+						tx[n++] = (d[x] << 4) | d[x+1];
+				}
+			}
+		}
+
+		for(y=0;y<8;y++)
+			memcpy(shadow + y*16 + q*8, monomeLedBuffer + y*16 + q*8, 8);
+	}
+
+	shadow_valid = 1;
+
+	t = Get_sys_count();
+	if(n) {
+		ftdi_write(tx, n);
+		frame_bytes += n;
+		window_bytes += n;
+	}
+	if(monomeFrameDirty)
+		(*monome_refresh)();
+
+	now = Get_sys_count();
+	frame_send_cy = now - t;
+	if(frame_send_cy > window_max)
+		window_max = frame_send_cy;
+	if(window_max > frame_send_max)
+		frame_send_max = window_max;
+
+	if(now - window_start >= FMCK_HZ) {
+		frame_bps = (u64)window_bytes * FMCK_HZ / (now - window_start);
+		frame_send_max = window_max;
+		window_bytes = 0;
+		window_max = 0;
+		window_start = now;
+	}
+}
+
+void frame_print_stats(void) {
+	print_dbg("\r\ngrid bytes/s ");
+	print_dbg_ulong(frame_bps);
+	print_dbg(" total ");
+	print_dbg_ulong(frame_bytes);
+	print_dbg(" held ");
+	print_dbg_ulong(frame_held);
+	print_dbg("\r\ngrid send us ");
+	print_dbg_ulong(cpu_cy_2_us(frame_send_cy, FMCK_HZ));
+	print_dbg(" max ");
+	print_dbg_ulong(cpu_cy_2_us(frame_send_max, FMCK_HZ));
+}
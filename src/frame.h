@@ -0,0 +1,23 @@
+#ifndef _FRAME_H_
+#define _FRAME_H_
+
+#include "types.h"
+
+// grid bytes sent: in total, and over the last second
+extern u32 frame_bytes;
+extern u32 frame_bps;
+
+// cycles spent handing the last frame to usb, and the most in the last second
+extern u32 frame_send_cy;
+extern u32 frame_send_max;
+
+// a drawn frame is waiting for the previous one to leave, and how many
+// frames have waited
+extern u8 frame_pending;
+extern u32 frame_held;
+
+extern void frame_reset(u8 size_x, u8 vari);
+extern void frame_send(void);
+extern void frame_print_stats(void);
+
+#endif
@@ -0,0 +1,163 @@
+// trigger outputs.
+//
+// all four outputs share one gpio port, so each step raises or lowers
+// every channel with a single masked port write. trigger pulses are ended
+// per channel by a one-shot tc, armed for the earliest pending deadline,
+// so pulse width no longer follows the clock duty cycle. deadlines are
+// kept in cycle counter time; the tc only wakes us up.
+
+#include "compiler.h"
+#include "cycle_counter.h"
+#include "intc.h"
+#include "tc.h"
+
+#include "conf_board.h"
+#include "gate.h"
+
+#define GATE_PORT (AVR32_GPIO.port[B00 >> 5])
+#define GATE_SHIFT (B00 & 0x1f)
+
+// tc clocked at pba/32, pba runs at the cpu clock: one tick is 32 cycles
+#define GATE_TC_DIV 32
+#define GATE_TC_MAX 0xffff
+// pulse used while the step period is still unknown
+#define GATE_DEFAULT_US 10000
+
+gate_width gate_widths[4] = {
+	{ gatePercent, 50 },
+	{ gatePercent, 50 },
+	{ gatePercent, 50 },
+	{ gatePercent, 50 }
+};
+
+static u32 deadline[4];
+static volatile u8 pending;
+
+
+static inline void gate_write(u8 high, u8 low) {
+	GATE_PORT.ovrs = (u32)high << GATE_SHIFT;
+	GATE_PORT.ovrc = (u32)low << GATE_SHIFT;
+}
+
+// arm the tc for the earliest pending deadline, or let it stop
+static void gate_arm(u32 now) {
+	u8 i1;
+	s32 d, next = 0;
+
+	for(i1=0;i1<4;i1++) {
+		if(pending & (1<<i1)) {
+			d = deadline[i1] - now;
+			if(next == 0 || d < next)
+				next = d;
+		}
+	}
+
+	if(pending == 0)
+		return;
+
+	next /= GATE_TC_DIV;
+	if(next < 1)
+		next = 1;
+	else if(next > GATE_TC_MAX)
+		next = GATE_TC_MAX;
+
+	tc_write_rc(GATE_TC, GATE_TC_CHANNEL, next);
+	tc_start(GATE_TC, GATE_TC_CHANNEL);
+}
+
+// end every pulse whose deadline has passed
+__attribute__((__interrupt__))
+static void irq_gate(void) {
+	u8 i1, low = 0;
+	u32 now;
+
+	tc_read_sr(GATE_TC, GATE_TC_CHANNEL);
+	now = Get_sys_count();
+
+	for(i1=0;i1<4;i1++)
+		if((pending & (1<<i1)) && (s32)(deadline[i1] - now) <= 0)
+			low |= 1<<i1;
+
+	gate_write(0, low);
+	pending &= ~low;
+	gate_arm(now);
+}
+
+void init_gate(void) {
+	static const tc_waveform_opt_t opt = {
+		.channel = GATE_TC_CHANNEL,
+		.bswtrg = TC_EVT_EFFECT_NOOP,
+		.beevt = TC_EVT_EFFECT_NOOP,
+		.bcpc = TC_EVT_EFFECT_NOOP,
+		.bcpb = TC_EVT_EFFECT_NOOP,
+		.aswtrg = TC_EVT_EFFECT_NOOP,
+		.aeevt = TC_EVT_EFFECT_NOOP,
+		.acpc = TC_EVT_EFFECT_NOOP,
+		.acpa = TC_EVT_EFFECT_NOOP,
+		.wavsel = TC_WAVEFORM_SEL_UP_MODE_RC_TRIGGER,
+		.enetrg = false,
+		.eevt = 0,
+		.eevtedg = TC_SEL_NO_EDGE,
+		.cpcdis = true,		// one-shot: stop on rc compare
+		.cpcstop = false,
+		.burst = false,
+		.clki = false,
+		.tcclks = TC_CLOCK_SOURCE_TC4
+	};
+	static const tc_interrupt_t irq = { .cpcs = 1 };
+
+	INTC_register_interrupt(&irq_gate, GATE_TC_IRQ, AVR32_INTC_INT3);
+	tc_init_waveform(GATE_TC, &opt);
+	tc_configure_interrupts(GATE_TC, GATE_TC_CHANNEL, &irq);
+}
+
+// raise mask and schedule the end of each pulse. period is the current
+// step length in cycles, 0 if not known yet.
+void gate_trigger(u8 mask, u32 period) {
+	u8 i1;
+	u32 now, width;
+	irqflags_t flags;
+
+	if(mask == 0)
+		return;
+
+	flags = cpu_irq_save();
+	now = Get_sys_count();
+	gate_write(mask, 0);
+
+	for(i1=0;i1<4;i1++) {
+		if(mask & (1<<i1)) {
+			if(gate_widths[i1].unit == gatePercent && period)
+				width = (u64)period * gate_widths[i1].value / 100;
+			else if(gate_widths[i1].unit == gatePercent)
+				width = cpu_us_2_cy(GATE_DEFAULT_US, FMCK_HZ);
+			else
+				width = cpu_us_2_cy(gate_widths[i1].value, FMCK_HZ);
+			deadline[i1] = now + width;
+		}
+	}
+	pending |= mask;
+	gate_arm(now);
+
+	cpu_irq_restore(flags);
+}
+
+// set held gates, cancelling any pulse still running on those outputs
+void gate_hold(u8 high, u8 low) {
+	irqflags_t flags = cpu_irq_save();
+
+	pending &= ~(high | low);
+	gate_write(high, low);
+
+	cpu_irq_restore(flags);
+}
+
+// lower every output with no pulse running, as the baseline did on each
+// falling clock phase in trigger mode
+void gate_release(void) {
+	irqflags_t flags = cpu_irq_save();
+
+	gate_write(0, 0xf & ~pending);
+
+	cpu_irq_restore(flags);
+}
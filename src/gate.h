@@ -0,0 +1,29 @@
+#ifndef _GATE_H_
+#define _GATE_H_
+
+#include "types.h"
+
+// tc channel used to end trigger pulses (channel 0 is the app timer)
+#define GATE_TC (&AVR32_TC)
+#define GATE_TC_CHANNEL 1
+#define GATE_TC_IRQ AVR32_TC_IRQ1
+
+// pulse width units
+typedef enum {
+	gateMicros,
+	gatePercent
+} gate_units;
+
+typedef struct {
+	gate_units unit;
+	u32 value;
+} gate_width;
+
+extern gate_width gate_widths[4];
+
+extern void init_gate(void);
+extern void gate_trigger(u8 mask, u32 period);
+extern void gate_hold(u8 high, u8 low);
+extern void gate_release(void);
+
+#endif
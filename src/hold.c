@@ -0,0 +1,87 @@
+// long press tracking.
+//
+// a pressed key gets a deadline in cycle counter time. deadlines are kept
+// sorted, soonest first, so a single one-shot timer armed for the first
+// one is all the waking needed, and a release is timed to the cycle
+// rather than to a polling tick. a key released while its deadline is
+// still pending was a fast press.
+
+#include "hold.h"
+
+typedef struct {
+	u32 at;
+	u8 key;
+} hold_t;
+
+static hold_t holds[HOLD_MAX];
+static u8 count;
+
+
+static void remove_at(u8 i) {
+	for(count--;i<count;i++)
+		holds[i] = holds[i+1];
+}
+
+// pending deadline for key, replacing any it had
+void hold_start(u8 key, u32 at) {
+	u8 i;
+
+	hold_cancel(key);
+	if(count == HOLD_MAX)
+		return;
+
+	for(i=count;i>0 && (s32)(holds[i-1].at - at) > 0;i--)
+		holds[i] = holds[i-1];
+	holds[i].at = at;
+	holds[i].key = key;
+	count++;
+}
+
+// drop the deadline of key. returns whether it was still pending
+u8 hold_cancel(u8 key) {
+	u8 i;
+
+	for(i=0;i<count;i++) {
+		if(holds[i].key == key) {
+			remove_at(i);
+			return 1;
+		}
+	}
+	return 0;
+}
+
+// take the first key whose deadline has passed, HOLD_NONE if none has
+u8 hold_due(u32 now) {
+	u8 key;
+
+	if(count == 0 || (s32)(holds[0].at - now) > 0)
+		return HOLD_NONE;
+
+	key = holds[0].key;
+	remove_at(0);
+	return key;
+}
+
+// cycles from now to the first deadline, if any is pending
+u8 hold_next(u32 now, u32 *cycles) {
+	s32 d;
+
+	if(count == 0)
+		return 0;
+
+	d = holds[0].at - now;
+	*cycles = d > 0 ? d : 0;
+	return 1;
+}
+
+// a grid went away: its held keys will never be released
+void hold_clear_keys(void) {
+	u8 i;
+
+	for(i=0;i<count;) {
+		if(holds[i].key < HOLD_FRONT)
+			remove_at(i);
+		else
+			i++;
+	}
+}
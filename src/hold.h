@@ -0,0 +1,18 @@
+#ifndef _HOLD_H_
+#define _HOLD_H_
+
+#include "types.h"
+
+// grid keys are y*16+x
+#define HOLD_FRONT 0x80
+#define HOLD_NONE 0xff
+
+#define HOLD_MAX 32
+
+extern void hold_start(u8 key, u32 at);
+extern u8 hold_cancel(u8 key);
+extern u8 hold_due(u32 now);
+extern u8 hold_next(u32 now, u32 *cycles);
+extern void hold_clear_keys(void);
+
+#endif
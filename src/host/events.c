@@ -0,0 +1,45 @@
+// host version of the libavr32 event queue.
+// an empty queue with nothing left in the firmware's own priority levels
+// means the firmware is idle: let the simulation run.
+
+#include "events.h"
+
+#include "sim.h"
+
+#define MAX_EVENTS 40
+
+// firmware
+extern u8 queue_pending(void);
+
+void (*app_event_handlers[kNumEventTypes])(s32 data);
+
+static event_t queue[MAX_EVENTS];
+static volatile u8 putIdx, getIdx;
+
+void init_events(void) {
+	putIdx = getIdx = 0;
+}
+
+u8 event_post(event_t *e) {
+	u8 next = (putIdx + 1) % MAX_EVENTS;
+
+	if(next == getIdx)
+		return 0;
+	queue[putIdx] = *e;
+	putIdx = next;
+	return 1;
+}
+
+u8 event_next(event_t *e) {
+	sim_sync();
+
+	while(getIdx == putIdx) {
+		if(queue_pending())
+			return 0;
+		sim_idle();
+	}
+
+	*e = queue[getIdx];
+	getIdx = (getIdx + 1) % MAX_EVENTS;
+	return 1;
+}
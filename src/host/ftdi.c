@@ -0,0 +1,29 @@
+// host version of the libavr32 ftdi layer: grid input is injected by the
+// simulator, output goes to the grid model in monome.c
+
+#include "events.h"
+#include "ftdi.h"
+
+#include "sim.h"
+
+// a write keeps the usb busy until the next 1 ms frame
+static u64 tx_ms = ~0ull;
+
+void ftdi_setup(void) { ;; }
+// a read completes at once, with whatever keys have arrived
+void ftdi_read(void) {
+	event_t e;
+
+	if(sim_monome_rx()) {
+		e.type = kEventMonomePoll;
+		e.data = 0;
+		event_post(&e);
+	}
+}
+
+void ftdi_write(u8 *data, u32 bytes) {
+	tx_ms = sim_ms;
+	sim_monome_write(data, bytes);
+}
+
+u8 ftdi_tx_busy(void) { return tx_ms == sim_ms; }
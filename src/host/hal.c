@@ -0,0 +1,447 @@
+// host stand-ins for the asf/libavr32 drivers used by main.c
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "compiler.h"
+#include "conf_board.h"
+#include "flashc.h"
+#include "gpio.h"
+#include "i2c.h"
+#include "init_common.h"
+#include "init_trilogy.h"
+#include "intc.h"
+#include "pdca.h"
+#include "print_funcs.h"
+#include "spi.h"
+#include "sysclk.h"
+#include "tc.h"
+#include "adc.h"
+#include "util.h"
+
+#include "sim.h"
+#include "../journal.h"
+
+avr32_spi_t sim_spi;
+volatile avr32_gpio_t AVR32_GPIO;
+volatile avr32_tc_t AVR32_TC;
+volatile clock_pulse_t clock_pulse;
+volatile u8 clock_external;
+volatile process_ii_t process_ii;
+
+u16 sim_adc[4];
+
+
+////////////////////////////////////////////////////////////////////////////////
+// gpio
+
+static u8 pins[64];
+
+static const char *pin_name(u32 pin) {
+	static char s[8];
+	snprintf(s, sizeof(s), "B%02u", pin - B00);
+	return s;
+}
+
+void sim_pin_set(u32 pin, int value) {
+	pins[pin & 63] = value != 0;
+}
+
+int sim_pin_get(u32 pin) {
+	return pins[pin & 63];
+}
+
+static void pin_write(u32 pin, int value) {
+	value = value != 0;
+	if(pins[pin & 63] == value)
+		return;
+	pins[pin & 63] = value;
+
+	if(pin >= B00 && pin <= B03 && value)
+		sim_out.tr_edges[pin - B00]++;
+	else if(pin == B10 && value)
+		sim_out.clock_edges++;
+
+	if(sim_trace)
+		fprintf(sim_trace, "%s pin %s %d\n", sim_stamp(), pin_name(pin), value);
+}
+
+void gpio_set_gpio_pin(u32 pin) { pin_write(pin, 1); }
+void gpio_clr_gpio_pin(u32 pin) { pin_write(pin, 0); }
+int gpio_get_pin_value(u32 pin) { return pins[pin & 63]; }
+
+// apply port register writes made since the last call
+void sim_sync(void) {
+	u8 port, i;
+	u32 set, clr;
+
+	for(port = 0; port < 2; port++) {
+		set = AVR32_GPIO.port[port].ovrs;
+		clr = AVR32_GPIO.port[port].ovrc;
+		AVR32_GPIO.port[port].ovrs = 0;
+		AVR32_GPIO.port[port].ovrc = 0;
+
+		for(i = 0; i < 32; i++) {
+			if(set & (1u << i))
+				pin_write(port * 32 + i, 1);
+			if(clr & (1u << i))
+				pin_write(port * 32 + i, 0);
+		}
+	}
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// interrupt controller and timer/counter
+
+static __int_handler tc_irq[3];
+static struct {
+	u32 div;
+	u16 rc;
+	u8 sr;
+	u8 running;
+	u64 deadline;
+} tc_ch[3];
+
+void INTC_register_interrupt(__int_handler handler, u32 irq, u32 int_level) {
+	if(irq >= AVR32_TC_IRQ0 && irq <= AVR32_TC_IRQ2)
+		tc_irq[irq - AVR32_TC_IRQ0] = handler;
+}
+
+int tc_init_waveform(volatile avr32_tc_t *tc, const tc_waveform_opt_t *opt) {
+	static const u32 div[] = { FPBA_HZ / 32768, 2, 8, 32, 128 };
+
+	tc_ch[opt->channel].div = div[opt->tcclks];
+	tc_ch[opt->channel].running = 0;
+	return 0;
+}
+
+int tc_configure_interrupts(volatile avr32_tc_t *tc, unsigned int channel, const tc_interrupt_t *bitfield) {
+	return 0;
+}
+
+int tc_write_rc(volatile avr32_tc_t *tc, unsigned int channel, unsigned short value) {
+	tc_ch[channel].rc = value;
+	return value;
+}
+
+int tc_start(volatile avr32_tc_t *tc, unsigned int channel) {
+	tc_ch[channel].running = 1;
+	tc_ch[channel].deadline = sim_cycles + (u64)tc_ch[channel].rc * tc_ch[channel].div;
+	return 0;
+}
+
+int tc_stop(volatile avr32_tc_t *tc, unsigned int channel) {
+	tc_ch[channel].running = 0;
+	return 0;
+}
+
+int tc_read_sr(volatile avr32_tc_t *tc, unsigned int channel) {
+	int sr = tc_ch[channel].sr;
+	tc_ch[channel].sr = 0;
+	return sr;
+}
+
+// earliest pending compare, or ~0 if no channel is running
+u64 sim_tc_next(void) {
+	u8 i;
+	u64 next = ~0ull;
+
+	for(i = 0; i < 3; i++)
+		if(tc_ch[i].running && tc_irq[i] && tc_ch[i].deadline < next)
+			next = tc_ch[i].deadline;
+	return next;
+}
+
+// fire every channel due at the current time. channels are one-shot
+// (cpcdis), which is all the firmware uses.
+void sim_tc_fire(void) {
+	u8 i;
+
+	for(i = 0; i < 3; i++) {
+		if(tc_ch[i].running && tc_irq[i] && tc_ch[i].deadline <= sim_cycles) {
+			tc_ch[i].running = 0;
+			tc_ch[i].sr = 1;
+			(*tc_irq[i])();
+		}
+	}
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// spi: decode 3-byte dac frames (command/address, data high, data low)
+
+static u8 spi_frame[8];
+static u8 spi_count;
+static u16 dac_input[2];
+
+spi_status_t spi_selectChip(volatile avr32_spi_t *spi, u8 chip) {
+	spi_count = 0;
+	return SPI_OK;
+}
+
+spi_status_t spi_write(volatile avr32_spi_t *spi, u16 data) {
+	if(spi_count < sizeof(spi_frame))
+		spi_frame[spi_count] = data;
+	spi_count++;
+	return SPI_OK;
+}
+
+static void dac_update(u8 ch, u16 value) {
+	if(sim_out.dac[ch] != value) {
+		sim_out.dac[ch] = value;
+		sim_out.dac_changes[ch]++;
+		if(sim_trace)
+			fprintf(sim_trace, "%s dac %c %u\n", sim_stamp(), 'A' + ch, value);
+	}
+}
+
+spi_status_t spi_unselectChip(volatile avr32_spi_t *spi, u8 chip) {
+	u8 cmd, addr, ch;
+	u16 value;
+
+	if(spi_count != 3) {
+		spi_count = 0;
+		return SPI_OK;
+	}
+
+	cmd = spi_frame[0] >> 4;
+	addr = spi_frame[0] & 0xf;
+	value = ((spi_frame[1] << 8) | spi_frame[2]) >> 4;
+	sim_out.dac_writes++;
+
+	for(ch = 0; ch < 2; ch++) {
+		if(!(addr & (ch ? 0x8 : 0x1)))
+			continue;
+		if(cmd == 1 || cmd == 3)		// write input register
+			dac_input[ch] = value;
+		if(cmd == 2 || cmd == 3)		// update dac register
+			dac_update(ch, dac_input[ch]);
+	}
+
+	spi_count = 0;
+	return SPI_OK;
+}
+
+spi_status_t spi_selectionMode(volatile avr32_spi_t *spi, unsigned char variable_ps, unsigned char pcs_decode, unsigned char delay) {
+	return SPI_OK;
+}
+
+void spi_enable(volatile avr32_spi_t *spi) { ;; }
+void spi_disable(volatile avr32_spi_t *spi) { ;; }
+
+
+////////////////////////////////////////////////////////////////////////////////
+// pdca: variable peripheral select words straight into the spi decoder
+
+static u8 pdca_pid[8];
+
+u32 pdca_init_channel(u8 ch, const pdca_channel_options_t *opt) {
+	pdca_pid[ch & 7] = opt->pid;
+	return 0;
+}
+
+void pdca_enable(u8 ch) { ;; }
+void pdca_disable(u8 ch) { ;; }
+
+void pdca_load_channel(u8 ch, volatile void *addr, u32 size) {
+	const volatile u32 *d = addr;
+	u8 selected = 0;
+
+	if(pdca_pid[ch & 7] != AVR32_PDCA_PID_SPI_TX)
+		return;
+
+	while(size--) {
+		if(!selected) {
+			spi_selectChip(&sim_spi, 0);
+			selected = 1;
+		}
+		spi_write(&sim_spi, *d & 0xffff);
+		if(*d & (1 << AVR32_SPI_TDR_LASTXFER_OFFSET)) {
+			spi_unselectChip(&sim_spi, 0);
+			selected = 0;
+		}
+		d++;
+	}
+}
+
+void pdca_reload_channel(u8 ch, volatile void *addr, u32 size) {
+	pdca_load_channel(ch, addr, size);
+}
+
+u32 pdca_get_load_size(u8 ch) { return 0; }
+u32 pdca_get_reload_size(u8 ch) { return 0; }
+
+
+////////////////////////////////////////////////////////////////////////////////
+// flash: the nvram section is linked read-only, so unprotect before writing.
+// a write with erase is a plain copy; without, it programs over what is
+// there, which can only clear bits. each page stalls the cpu for
+// sim_flash_us erased and written, half that written only.
+//
+// the journal can be kept in a file between runs (sim_nvram), and the
+// power can be cut partway through the sim_flash_cut'th page written
+
+#define FLASH_PAGE 512
+
+static u32 flash_pages;
+
+static void flash_unprotect(volatile void *dst, size_t nbytes) {
+	long page = sysconf(_SC_PAGESIZE);
+	uintptr_t start = (uintptr_t)dst & ~(uintptr_t)(page - 1);
+	uintptr_t end = (uintptr_t)dst + nbytes;
+
+	mprotect((void *)start, end - start, PROT_READ | PROT_WRITE);
+}
+
+static void nvram_save(void) {
+	FILE *f = fopen(sim_nvram, "wb");
+
+	if(!f || fwrite(journal_flash, sizeof(journal_flash), 1, f) != 1)
+		perror(sim_nvram);
+	if(f)
+		fclose(f);
+}
+
+// a fresh chip reads erased
+static void nvram_load(void) {
+	FILE *f = fopen(sim_nvram, "rb");
+
+	flash_unprotect(journal_flash, sizeof(journal_flash));
+	if(!f || fread(journal_flash, sizeof(journal_flash), 1, f) != 1)
+		memset(journal_flash, 0xff, sizeof(journal_flash));
+	if(f)
+		fclose(f);
+	atexit(&nvram_save);
+}
+
+// the power goes while a page is written: an erase has finished and some
+// of the page is programmed, in order, the rest left as it was
+static void flash_cut(u8 *page, const u8 *want, bool erase) {
+	u32 i, k = (flash_pages * 2654435761u >> 7) % FLASH_PAGE;
+
+	if(erase)
+		memset(page, 0xff, FLASH_PAGE);
+	for(i = 0; i < k; i++)
+		page[i] &= want[i];
+	printf("\r\npower cut: page %u, %u of %u bytes written\n", flash_pages, k, FLASH_PAGE);
+	exit(3);
+}
+
+// program src over dst a page at a time
+static void flash_write(volatile void *dst, const u8 *src, size_t nbytes, bool erase) {
+	u8 want[FLASH_PAGE];
+	u8 *d = (u8 *)dst, *page;
+	size_t i, n;
+
+	flash_unprotect(dst, nbytes);
+	while(nbytes) {
+		page = (u8 *)((uintptr_t)d & ~(uintptr_t)(FLASH_PAGE - 1));
+		n = page + FLASH_PAGE - d;
+		if(n > nbytes)
+			n = nbytes;
+
+		memcpy(want, page, FLASH_PAGE);
+		for(i = 0; i < n; i++)
+			want[d - page + i] = erase ? src[i] : want[d - page + i] & src[i];
+
+		if(++flash_pages == sim_flash_cut)
+			flash_cut(page, want, erase);
+		memcpy(page, want, FLASH_PAGE);
+		sim_stall(erase ? sim_flash_us : sim_flash_us / 2);
+
+		d += n;
+		src += n;
+		nbytes -= n;
+	}
+}
+
+volatile void *flashc_memset8(volatile void *dst, u8 src, size_t nbytes, bool erase) {
+	u8 b[FLASH_PAGE];
+	size_t n;
+	u8 *d = (u8 *)dst;
+
+	memset(b, src, sizeof(b));
+	while(nbytes) {
+		n = nbytes < sizeof(b) ? nbytes : sizeof(b);
+		flash_write(d, b, n, erase);
+		d += n;
+		nbytes -= n;
+	}
+	return dst;
+}
+
+volatile void *flashc_memset32(volatile void *dst, u32 src, size_t nbytes, bool erase) {
+	u8 b[FLASH_PAGE];
+	size_t i, n;
+	u8 *d = (u8 *)dst;
+
+	// big-endian, as on avr32
+	for(i = 0; i < sizeof(b); i++)
+		b[i] = src >> (8 * (3 - (i & 3)));
+	while(nbytes) {
+		n = nbytes < sizeof(b) ? nbytes : sizeof(b);
+		flash_write(d, b, n, erase);
+		d += n;
+		nbytes -= n;
+	}
+	return dst;
+}
+
+volatile void *flashc_memcpy(volatile void *dst, const void *src, size_t nbytes, bool erase) {
+	flash_write(dst, src, nbytes, erase);
+	return dst;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// adc
+
+void init_adc(void) { ;; }
+
+void adc_convert(u16 (*dst)[4]) {
+	memcpy(*dst, sim_adc, sizeof(sim_adc));
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// debug uart
+
+void init_dbg_rs232(long pba_hz) { ;; }
+void print_dbg(const char *str) { fputs(str, stdout); }
+void print_dbg_char(int c) { putchar(c); }
+void print_dbg_ulong(unsigned long n) { printf("%lu", n); }
+void print_dbg_hex(unsigned long n) { printf("%08lx", n); }
+
+
+////////////////////////////////////////////////////////////////////////////////
+// libavr32 util: same lcg as the firmware
+
+u32 rnd(void) {
+	static u32 x = 777;
+	x = x * 1664525L + 1013904223L;
+	return x;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// init stubs
+
+void sysclk_init(void) { ;; }
+void init_gpio(void) { ;; }
+void init_tc(void) { ;; }
+void init_spi(void) { ;; }
+void init_usb_host(void) { ;; }
+void register_interrupts(void) { ;; }
+void init_i2c_slave(uint8_t addr) { ;; }
+
+void sim_hal_init(void) {
+	// clock input normalled (nothing patched) until the scenario says otherwise
+	pins[B09 & 63] = 1;
+
+	if(sim_nvram)
+		nvram_load();
+}
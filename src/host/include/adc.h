@@ -0,0 +1,11 @@
+#ifndef _ADC_H_
+#define _ADC_H_
+
+// host stand-in for libavr32 adc.h. values come from the simulated pots.
+
+#include "types.h"
+
+extern void init_adc(void);
+extern void adc_convert(u16 (*dst)[4]);
+
+#endif
@@ -0,0 +1,49 @@
+#ifndef _COMPILER_H_
+#define _COMPILER_H_
+
+// host stand-in for the ASF compiler.h
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "types.h"
+
+// the few avr32/io.h register fields the firmware uses
+#define AVR32_SPI_TDR_PCS_OFFSET 16
+#define AVR32_SPI_TDR_LASTXFER_OFFSET 24
+#define AVR32_PDCA_PID_SPI_TX 5
+
+// gpio output registers; writes are applied to the simulated pins after
+// every firmware call (see sim_sync)
+typedef struct {
+	u32 gper, gpers, gperc, gpert;
+	u32 pmr0, pmr0s, pmr0c, pmr0t;
+	u32 pmr1, pmr1s, pmr1c, pmr1t;
+	u32 reserved0[4];
+	u32 oder, oders, oderc, odert;
+	u32 ovr, ovrs, ovrc, ovrt;
+	u32 pvr;
+} avr32_gpio_port_t;
+
+typedef struct {
+	avr32_gpio_port_t port[2];
+} avr32_gpio_t;
+
+extern volatile avr32_gpio_t AVR32_GPIO;
+
+// interrupts are simulated by calling handlers between firmware calls,
+// so there is nothing to mask
+#define __interrupt__ __unused__
+
+typedef u32 irqflags_t;
+
+#define cpu_irq_enable()
+#define cpu_irq_disable()
+#define cpu_irq_save() ((irqflags_t)0)
+#define cpu_irq_restore(flags) ((void)(flags))
+#define irq_initialize_vectors()
+
+#endif
@@ -0,0 +1,30 @@
+#ifndef _CONF_BOARD_H_
+#define _CONF_BOARD_H_
+
+// host stand-in for the trilogy board configuration
+
+#include "compiler.h"
+#include "spi.h"
+
+#define FMCK_HZ 60000000
+#define FPBA_HZ 60000000
+
+// uc3b pin numbering: port b starts at 32
+#define B00 32
+#define B01 33
+#define B02 34
+#define B03 35
+#define B04 36
+#define B05 37
+#define B06 38
+#define B07 39
+#define B08 40
+#define B09 41
+#define B10 42
+#define B11 43
+
+#define SPI (&sim_spi)
+#define DAC_SPI (&sim_spi)
+#define DAC_SPI_NPCS 0
+
+#endif
@@ -0,0 +1,17 @@
+#ifndef _CYCLE_COUNTER_H_
+#define _CYCLE_COUNTER_H_
+
+// host stand-in for the ASF cycle counter: the simulated COUNT register
+// follows the virtual clock, plus host time spent inside the firmware
+
+#include "compiler.h"
+
+extern u32 sim_sys_count(void);
+
+#define Get_sys_count() sim_sys_count()
+
+#define cpu_cy_2_us(cy, fcpu) ((u32)(((u64)(cy) * 1000000) / (fcpu)))
+#define cpu_us_2_cy(us, fcpu) ((u32)(((u64)(us) * (fcpu)) / 1000000))
+#define cpu_ms_2_cy(ms, fcpu) ((u32)(((u64)(ms) * (fcpu)) / 1000))
+
+#endif
@@ -0,0 +1,8 @@
+#ifndef _DELAY_H_
+#define _DELAY_H_
+
+// host stand-in for the ASF delay driver: nothing to configure
+
+#include "compiler.h"
+
+#endif
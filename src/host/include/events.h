@@ -0,0 +1,52 @@
+#ifndef _EVENTS_H_
+#define _EVENTS_H_
+
+// host stand-in for libavr32 events.h
+
+#include "types.h"
+
+typedef enum {
+	kEventFront,
+	kEventFrontShort,
+	kEventFrontLong,
+	kEventPollADC,
+	kEventKeyTimer,
+	kEventSaveFlash,
+	kEventClockNormal,
+	kEventClockExt,
+	kEventFtdiConnect,
+	kEventFtdiDisconnect,
+	kEventHidConnect,
+	kEventHidDisconnect,
+	kEventHidPacket,
+	kEventHidTimer,
+	kEventMidiConnect,
+	kEventMidiDisconnect,
+	kEventMidiPacket,
+	kEventMidiRefresh,
+	kEventTrigger,
+	kEventScreenRefresh,
+	kEventII,
+	kEventMonomeConnect,
+	kEventMonomeDisconnect,
+	kEventMonomePoll,
+	kEventMonomeRefresh,
+	kEventMonomeGridKey,
+	kEventMonomeRingEnc,
+	kEventTimer,
+	kEventSerial,
+	kNumEventTypes
+} etype;
+
+typedef struct {
+	etype type;
+	s32 data;
+} event_t;
+
+extern void (*app_event_handlers[])(s32 data);
+
+extern void init_events(void);
+extern u8 event_post(event_t *e);
+extern u8 event_next(event_t *e);
+
+#endif
@@ -0,0 +1,13 @@
+#ifndef _FLASHC_H_
+#define _FLASHC_H_
+
+// host stand-in for the ASF flash controller driver.
+// writes land directly in the (made writable) .flash_nvram section.
+
+#include "compiler.h"
+
+extern volatile void *flashc_memset8(volatile void *dst, u8 src, size_t nbytes, bool erase);
+extern volatile void *flashc_memset32(volatile void *dst, u32 src, size_t nbytes, bool erase);
+extern volatile void *flashc_memcpy(volatile void *dst, const void *src, size_t nbytes, bool erase);
+
+#endif
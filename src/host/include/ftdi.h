@@ -0,0 +1,13 @@
+#ifndef _FTDI_H_
+#define _FTDI_H_
+
+// host stand-in for libavr32 ftdi.h
+
+#include "types.h"
+
+extern void ftdi_setup(void);
+extern void ftdi_read(void);
+extern void ftdi_write(u8 *data, u32 bytes);
+extern u8 ftdi_tx_busy(void);
+
+#endif
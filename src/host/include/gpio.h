@@ -0,0 +1,13 @@
+#ifndef _GPIO_H_
+#define _GPIO_H_
+
+// host stand-in for the ASF gpio driver. pin state is kept by the
+// simulator, which records every edge.
+
+#include "compiler.h"
+
+extern void gpio_set_gpio_pin(u32 pin);
+extern void gpio_clr_gpio_pin(u32 pin);
+extern int gpio_get_pin_value(u32 pin);
+
+#endif
@@ -0,0 +1,13 @@
+#ifndef _I2C_H_
+#define _I2C_H_
+
+// host stand-in for libavr32 i2c.h
+
+#include <stdint.h>
+
+typedef void (*process_ii_t)(uint8_t *data, uint8_t l);
+extern volatile process_ii_t process_ii;
+
+extern void init_i2c_slave(uint8_t addr);
+
+#endif
@@ -0,0 +1,22 @@
+#ifndef _II_H_
+#define _II_H_
+
+// host stand-in for the ii command table
+
+#define WW 0x10
+#define WW_PRESET 0
+#define WW_POS 1
+#define WW_SYNC 2
+#define WW_START 3
+#define WW_END 4
+#define WW_PMODE 5
+#define WW_PATTERN 6
+#define WW_QPATTERN 7
+#define WW_MUTE1 8
+#define WW_MUTE2 9
+#define WW_MUTE3 10
+#define WW_MUTE4 11
+#define WW_MUTEA 12
+#define WW_MUTEB 13
+
+#endif
@@ -0,0 +1,17 @@
+#ifndef _INIT_COMMON_H_
+#define _INIT_COMMON_H_
+
+// host stand-in for libavr32 init_common.h
+
+#include "types.h"
+
+typedef void (*clock_pulse_t)(u8 phase);
+extern volatile clock_pulse_t clock_pulse;
+extern volatile u8 clock_external;
+
+extern void register_interrupts(void);
+extern void init_tc(void);
+extern void init_spi(void);
+extern void init_usb_host(void);
+
+#endif
@@ -0,0 +1,8 @@
+#ifndef _INIT_TRILOGY_H_
+#define _INIT_TRILOGY_H_
+
+// host stand-in for libavr32 init_trilogy.h
+
+extern void init_gpio(void);
+
+#endif
@@ -0,0 +1,22 @@
+#ifndef _INTC_H_
+#define _INTC_H_
+
+// host stand-in for the ASF interrupt controller driver. handlers are
+// kept by the simulator and called when their peripheral fires.
+
+#include "compiler.h"
+
+#define AVR32_INTC_INT0 0
+#define AVR32_INTC_INT1 1
+#define AVR32_INTC_INT2 2
+#define AVR32_INTC_INT3 3
+
+#define AVR32_TC_IRQ0 448
+#define AVR32_TC_IRQ1 449
+#define AVR32_TC_IRQ2 450
+
+typedef void (*__int_handler)(void);
+
+extern void INTC_register_interrupt(__int_handler handler, u32 irq, u32 int_level);
+
+#endif
@@ -0,0 +1,25 @@
+#ifndef _MONOME_H_
+#define _MONOME_H_
+
+// host stand-in for libavr32 monome.h
+
+#include "types.h"
+
+#define MONOME_MAX_LED_BYTES 256
+
+typedef void (*refresh_t)(void);
+
+extern u8 monomeLedBuffer[MONOME_MAX_LED_BYTES];
+extern u8 monomeFrameDirty;
+extern refresh_t monome_refresh;
+
+extern void init_monome(void);
+extern u8 monome_size_x(void);
+extern u8 monome_size_y(void);
+extern u8 monome_is_vari(void);
+extern void monome_set_quadrant_flag(u8 q);
+extern void monome_calc_quadrant_flag(u8 x, u8 y);
+extern void monome_read_serial(void);
+extern void monome_grid_key_parse_event_data(u32 data, u8 *x, u8 *y, u8 *val);
+
+#endif
@@ -0,0 +1,30 @@
+#ifndef _PDCA_H_
+#define _PDCA_H_
+
+// host stand-in for the ASF pdca driver. a loaded buffer is clocked out
+// to the simulated spi at once, so channels never report as busy.
+
+#include "compiler.h"
+
+#define PDCA_TRANSFER_SIZE_BYTE 0
+#define PDCA_TRANSFER_SIZE_HALF_WORD 1
+#define PDCA_TRANSFER_SIZE_WORD 2
+
+typedef struct {
+	volatile void *addr;
+	u32 size;
+	volatile void *r_addr;
+	u32 r_size;
+	u32 pid;
+	u8 transfer_size;
+} pdca_channel_options_t;
+
+extern u32 pdca_init_channel(u8 ch, const pdca_channel_options_t *opt);
+extern void pdca_enable(u8 ch);
+extern void pdca_disable(u8 ch);
+extern void pdca_load_channel(u8 ch, volatile void *addr, u32 size);
+extern void pdca_reload_channel(u8 ch, volatile void *addr, u32 size);
+extern u32 pdca_get_load_size(u8 ch);
+extern u32 pdca_get_reload_size(u8 ch);
+
+#endif
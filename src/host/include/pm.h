@@ -0,0 +1,8 @@
+#ifndef _PM_H_
+#define _PM_H_
+
+// host stand-in for the ASF pm driver: nothing to configure
+
+#include "compiler.h"
+
+#endif
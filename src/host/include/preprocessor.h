@@ -0,0 +1,8 @@
+#ifndef _PREPROCESSOR_H_
+#define _PREPROCESSOR_H_
+
+// host stand-in for the ASF preprocessor driver: nothing to configure
+
+#include "compiler.h"
+
+#endif
@@ -0,0 +1,14 @@
+#ifndef _PRINT_FUNCS_H_
+#define _PRINT_FUNCS_H_
+
+// host stand-in for the ASF debug uart: output goes to stdout
+
+#include "compiler.h"
+
+extern void init_dbg_rs232(long pba_hz);
+extern void print_dbg(const char *str);
+extern void print_dbg_char(int c);
+extern void print_dbg_ulong(unsigned long n);
+extern void print_dbg_hex(unsigned long n);
+
+#endif
@@ -0,0 +1,25 @@
+#ifndef _SPI_H_
+#define _SPI_H_
+
+// host stand-in for the ASF spi driver. bytes sent to the dac chip
+// select are decoded into dac channel writes by the simulator.
+
+#include "compiler.h"
+
+typedef enum {
+	SPI_ERROR = -1,
+	SPI_OK = 0
+} spi_status_t;
+
+typedef struct { u32 dummy; } avr32_spi_t;
+
+extern avr32_spi_t sim_spi;
+
+extern spi_status_t spi_selectChip(volatile avr32_spi_t *spi, u8 chip);
+extern spi_status_t spi_unselectChip(volatile avr32_spi_t *spi, u8 chip);
+extern spi_status_t spi_write(volatile avr32_spi_t *spi, u16 data);
+extern spi_status_t spi_selectionMode(volatile avr32_spi_t *spi, unsigned char variable_ps, unsigned char pcs_decode, unsigned char delay);
+extern void spi_enable(volatile avr32_spi_t *spi);
+extern void spi_disable(volatile avr32_spi_t *spi);
+
+#endif
@@ -0,0 +1,10 @@
+#ifndef _SYSCLK_H_
+#define _SYSCLK_H_
+
+// host stand-in for the ASF sysclk service
+
+#include "compiler.h"
+
+extern void sysclk_init(void);
+
+#endif
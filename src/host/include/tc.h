@@ -0,0 +1,46 @@
+#ifndef _TC_H_
+#define _TC_H_
+
+// host stand-in for the ASF timer/counter driver: a channel started with
+// tc_start() raises its rc compare interrupt after rc ticks of virtual time.
+
+#include "compiler.h"
+
+#define TC_EVT_EFFECT_NOOP 0
+#define TC_SEL_NO_EDGE 0
+#define TC_WAVEFORM_SEL_UP_MODE 0
+#define TC_WAVEFORM_SEL_UP_MODE_RC_TRIGGER 2
+
+#define TC_CLOCK_SOURCE_TC1 0
+#define TC_CLOCK_SOURCE_TC2 1
+#define TC_CLOCK_SOURCE_TC3 2
+#define TC_CLOCK_SOURCE_TC4 3
+#define TC_CLOCK_SOURCE_TC5 4
+
+typedef struct { u32 dummy; } avr32_tc_t;
+
+extern volatile avr32_tc_t AVR32_TC;
+
+typedef struct {
+	unsigned int channel;
+	unsigned int bswtrg, beevt, bcpc, bcpb;
+	unsigned int aswtrg, aeevt, acpc, acpa;
+	unsigned int wavsel;
+	bool enetrg;
+	unsigned int eevt, eevtedg;
+	bool cpcdis, cpcstop, burst, clki;
+	unsigned int tcclks;
+} tc_waveform_opt_t;
+
+typedef struct {
+	unsigned int etrgs, ldrbs, ldras, cpcs, cpbs, cpas, lovrs, covfs;
+} tc_interrupt_t;
+
+extern int tc_init_waveform(volatile avr32_tc_t *tc, const tc_waveform_opt_t *opt);
+extern int tc_configure_interrupts(volatile avr32_tc_t *tc, unsigned int channel, const tc_interrupt_t *bitfield);
+extern int tc_write_rc(volatile avr32_tc_t *tc, unsigned int channel, unsigned short value);
+extern int tc_start(volatile avr32_tc_t *tc, unsigned int channel);
+extern int tc_stop(volatile avr32_tc_t *tc, unsigned int channel);
+extern int tc_read_sr(volatile avr32_tc_t *tc, unsigned int channel);
+
+#endif
@@ -0,0 +1,27 @@
+#ifndef _TIMERS_H_
+#define _TIMERS_H_
+
+// host stand-in for libavr32 timers.h: a linked list of software timers
+// serviced once per (simulated) millisecond tick.
+
+#include "compiler.h"
+
+typedef void (*timer_callback_t)(void *caller);
+
+typedef struct _softTimer {
+	u32 ticksRemain;
+	u32 ticks;
+	timer_callback_t callback;
+	void *caller;
+	struct _softTimer *next;
+	struct _softTimer *prev;
+} softTimer_t;
+
+extern bool timer_add(softTimer_t *timer, u32 ticks, timer_callback_t callback, void *caller);
+extern bool timer_remove(softTimer_t *timer);
+extern void timer_set(softTimer_t *timer, u32 ticks);
+extern void timer_reset(softTimer_t *timer);
+extern void timer_reset_set(softTimer_t *timer, u32 ticks);
+extern void process_timers(void);
+
+#endif
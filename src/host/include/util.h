@@ -0,0 +1,10 @@
+#ifndef _UTIL_H_
+#define _UTIL_H_
+
+// host stand-in for libavr32 util.h
+
+#include "types.h"
+
+extern u32 rnd(void);
+
+#endif
@@ -0,0 +1,154 @@
+// host version of the libavr32 monome layer and of the grid itself: key
+// presses wait for the firmware's ftdi poll like on the hardware, and led
+// output, whether quadrant refreshes or mext messages on the ftdi, is
+// applied to a model of the grid's leds, counted and traced as a hash.
+
+#include <stdio.h>
+#include <string.h>
+
+#include "events.h"
+#include "monome.h"
+
+#include "sim.h"
+
+u8 monomeLedBuffer[MONOME_MAX_LED_BYTES];
+u8 monomeFrameDirty;
+refresh_t monome_refresh;
+
+static u8 size_x = 16, size_y = 8, vari = 1;
+
+void init_monome(void) { ;; }
+u8 monome_size_x(void) { return size_x; }
+u8 monome_size_y(void) { return size_y; }
+u8 monome_is_vari(void) { return vari; }
+// presses waiting in the ftdi's receive buffer until the next read
+#define RX_MAX 64
+
+static u32 rx[RX_MAX];
+static u8 rx_count;
+
+void sim_monome_key(u8 x, u8 y, u8 z) {
+	if(rx_count < RX_MAX)
+		rx[rx_count++] = x | (y << 8) | (z << 16);
+}
+
+u8 sim_monome_rx(void) { return rx_count; }
+
+// the read landed: one event per key, as the libavr32 parser posts them
+void monome_read_serial(void) {
+	event_t e;
+	u8 i;
+
+	e.type = kEventMonomeGridKey;
+	for(i = 0; i < rx_count; i++) {
+		e.data = rx[i];
+		event_post(&e);
+	}
+	rx_count = 0;
+}
+
+void monome_set_quadrant_flag(u8 q) {
+	monomeFrameDirty |= 1 << q;
+}
+
+void monome_calc_quadrant_flag(u8 x, u8 y) {
+	monome_set_quadrant_flag((x > 7) + ((y > 7) << 1));
+}
+
+void monome_grid_key_parse_event_data(u32 data, u8 *x, u8 *y, u8 *val) {
+	*x = data & 0xff;
+	*y = (data >> 8) & 0xff;
+	*val = (data >> 16) & 0xff;
+}
+
+// leds as the grid shows them
+u8 sim_grid[128];
+
+static void grid_traced(void) {
+	u8 i;
+	u32 hash = 2166136261u;
+
+	sim_out.led_frames++;
+	if(sim_trace) {
+		for(i = 0; i < 128; i++)
+			hash = (hash ^ sim_grid[i]) * 16777619u;
+		fprintf(sim_trace, "%s led %08x\n", sim_stamp(), hash);
+	}
+}
+
+// libavr32 quadrant refresh: whole quadrants as maps
+static void sim_monome_refresh(void) {
+	u8 q, y;
+
+	for(q = 0; q < 2; q++) {
+		if(monomeFrameDirty & (1 << q)) {
+			sim_out.led_maps++;
+			// mext /led/level/map or /led/map: header + payload
+			sim_out.led_bytes += vari ? 3 + 32 : 3 + 8;
+			for(y = 0; y < 8; y++)
+				memcpy(sim_grid + y * 16 + q * 8, monomeLedBuffer + y * 16 + q * 8, 8);
+		}
+	}
+	monomeFrameDirty = 0;
+	grid_traced();
+}
+
+static void unpack(u8 *d, const u8 *p, u8 n) {
+	u8 i;
+
+	for(i = 0; i < n; i += 2) {
+		d[i] = p[i / 2] >> 4;
+		d[i + 1] = p[i / 2] & 0xf;
+	}
+}
+
+// mext led messages written straight to the ftdi
+void sim_monome_write(const u8 *p, u32 n) {
+	const u8 *end = p + n;
+	u8 y;
+
+	sim_out.led_bytes += n;
+
+	while(p < end) {
+		switch(p[0]) {
+		case 0x18:	// /led/level/set x y l
+			sim_grid[p[2] * 16 + p[1]] = p[3];
+			sim_out.led_sets++;
+			p += 4;
+			break;
+		case 0x1a:	// /led/level/map x y d[32]
+			for(y = 0; y < 8; y++)
+				unpack(sim_grid + y * 16 + p[1], p + 3 + y * 4, 8);
+			sim_out.led_maps++;
+			p += 35;
+			break;
+		case 0x1b:	// /led/level/row x y d[4]
+			unpack(sim_grid + p[2] * 16 + p[1], p + 3, 8);
+			sim_out.led_rows++;
+			p += 7;
+			break;
+		default:
+			fprintf(stderr, "sim: unknown mext message %02x\n", p[0]);
+			return;
+		}
+	}
+	grid_traced();
+}
+
+// after each refresh the grid should show exactly the firmware's frame
+void sim_monome_check(void) {
+	u8 x, y;
+
+	for(y = 0; y < 8; y++)
+		for(x = 0; x < size_x; x++)
+			if(sim_grid[y * 16 + x] != monomeLedBuffer[y * 16 + x]) {
+				sim_out.led_mismatches++;
+				return;
+			}
+}
+
+void sim_monome_connect(u8 x, u8 v) {
+	size_x = x;
+	vari = v;
+	monome_refresh = &sim_monome_refresh;
+}
@@ -0,0 +1,99 @@
+// random.h against the libavr32 rnd() it replaced: time per draw, and
+// chi-square tests of single draws and of consecutive pairs.
+//
+// the old code drew rnd() % n. the pairs test shows why that was poor as
+// well as slow: the low bits of an lcg repeat with a short period, so for
+// small power-of-two ranges each draw all but fixes the next.
+//
+// exits 1 if the new generator fails a test.
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "../random.h"
+
+#define DRAWS 10000000
+#define CELLS_MAX 256
+
+typedef u32 (*draw_fn)(u32 n);
+
+static random_t stream;
+
+static u32 rnd(void) {
+	static u32 x = 777;
+	x = x * 1664525L + 1013904223L;
+	return x;
+}
+
+static u32 draw_old(u32 n) { return rnd() % n; }
+static u32 draw_new(u32 n) { return random_range(&stream, n); }
+
+static double now_ns(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static double bench(draw_fn f, u32 n) {
+	volatile u32 sink = 0;
+	double t = now_ns();
+	u32 i;
+
+	for(i = 0; i < DRAWS; i++)
+		sink += f(n);
+	return (now_ns() - t) / DRAWS;
+}
+
+// chi-square of draws (pairs = 0) or of consecutive pairs over n*n cells,
+// as a z score against its degrees of freedom
+static double chi_z(draw_fn f, u32 n, u8 pairs) {
+	static u32 count[CELLS_MAX * CELLS_MAX];
+	u32 cells = pairs ? n * n : n;
+	u32 draws = cells * 1000;
+	u32 i, a, b = f(n);
+	double e = 1000., chi = 0;
+
+	memset(count, 0, cells * sizeof(count[0]));
+	for(i = 0; i < draws; i++) {
+		a = b;
+		b = f(n);
+		count[pairs ? a * n + b : b]++;
+	}
+	for(i = 0; i < cells; i++)
+		chi += (count[i] - e) * (count[i] - e) / e;
+	return (chi - (cells - 1)) / sqrt(2. * (cells - 1));
+}
+
+int main(void) {
+	static const u32 ranges[] = { 3, 7, 16, 255 };
+	u32 i, n;
+	double z1, z2;
+	int fail = 0;
+
+	random_seed(&stream, 1);
+
+	printf("draw time (ns), host: old rnd() %% n / random_range\n");
+	for(i = 0; i < sizeof(ranges) / sizeof(ranges[0]); i++) {
+		n = ranges[i];
+		printf("  n %3u  %6.2f / %6.2f\n", n, bench(&draw_old, n), bench(&draw_new, n));
+	}
+
+	printf("chi-square z, single / pairs (|z| under 4 passes)\n");
+	for(i = 0; i < sizeof(ranges) / sizeof(ranges[0]); i++) {
+		n = ranges[i];
+		z1 = chi_z(&draw_old, n, 0);
+		z2 = chi_z(&draw_old, n, 1);
+		printf("  n %3u  old %10.1f / %10.1f", n, z1, z2);
+		z1 = chi_z(&draw_new, n, 0);
+		z2 = chi_z(&draw_new, n, 1);
+		printf("  new %6.1f / %6.1f\n", z1, z2);
+		if(fabs(z1) > 4 || fabs(z2) > 4)
+			fail = 1;
+	}
+
+	printf("random: %s\n", fail ? "FAIL" : "ok");
+	return fail;
+}
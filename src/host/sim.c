@@ -0,0 +1,439 @@
+// simulation scenario: virtual clock, grid/clock/pot stimulus and report.
+//
+// configured through the environment:
+//
+//   SIM_MS       length of the run in simulated milliseconds (default 1 hour)
+//   SIM_SEED     seed for the generated key stream (default 1)
+//   SIM_KEYS     replay a recorded key stream ("ms x y z" per line) instead
+//                of generating one
+//   SIM_RATE     generated key presses per second (default 4, 0 for none)
+//   SIM_RECORD   write the key stream that was played to this file
+//   SIM_TRACE    write every dac, pin and led change to this file
+//   SIM_EXT      external clock period in ms (default 0: internal clock)
+//   SIM_TEMPO    clock pot position, 0-4095 (default 2048)
+//   SIM_PARAM    param pot position, 0-4095 (default 2048)
+//   SIM_GRID     grid width, 8 or 16 (default 16)
+//   SIM_MONO     1 for a non-varibright grid
+//   SIM_LOOKAHEAD  0 to resolve each step on its clock edge
+//   SIM_EXACT    1 to leave host time out of the cycle counter, so runs
+//                repeat exactly (firmware timings then read as zero)
+//   SIM_FRONT    hold the front button for a second every this many ms,
+//                saving the preset (default 0: never)
+//   SIM_FLASH_US cpu stall per flash page erased and written (default 4000)
+//   SIM_II       send WW.PRESET every this many ms, stepping through the
+//                presets (default 0: never)
+//   SIM_NVRAM    keep the preset journal in this file between runs
+//   SIM_CUT      cut the power partway through this flash page write,
+//                counting from 1, and exit with status 3
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "conf_board.h"
+#include "events.h"
+#include "i2c.h"
+#include "ii.h"
+#include "init_common.h"
+#include "monome.h"
+#include "timers.h"
+
+#include "sim.h"
+
+u64 sim_cycles;
+u64 sim_ms;
+static u64 tick_ns;
+FILE *sim_trace;
+sim_out_t sim_out;
+
+static u64 run_ms = 3600000;
+static u32 ext_ms;
+static u32 key_rate = 4;
+static u32 seed = 1;
+static u32 exact;
+static u32 front_ms;
+static u32 ii_ms;
+u32 sim_flash_us;
+u32 sim_flash_cut;
+const char *sim_nvram;
+static FILE *keys_in, *keys_out;
+
+static sim_stat_t stat_clock_hi = { "clock(1)" };
+static sim_stat_t stat_clock_lo = { "clock(0)" };
+static sim_stat_t stat_grid_key = { "grid key" };
+static sim_stat_t stat_refresh = { "refresh" };
+static sim_stat_t stat_ii = { "ii" };
+
+static clock_pulse_t fw_clock;
+static void (*fw_grid_key)(s32 data);
+static void (*fw_refresh)(s32 data);
+static void (*fw_clock_ext)(s32 data);
+static process_ii_t fw_ii;
+
+// firmware
+extern u8 step_lookahead;
+extern u8 frame_pending;
+extern void clock_print_stats(void);
+extern void frame_print_stats(void);
+extern void refresh_print_stats(void);
+extern void queue_print_stats(void);
+extern void store_print_stats(void);
+extern void journal_print_stats(void);
+extern void flash_print_stats(void);
+
+
+////////////////////////////////////////////////////////////////////////////////
+// timing
+
+u64 sim_ns(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (u64)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+void sim_stat_add(sim_stat_t *s, u64 ns) {
+	if(s->n == 0 || ns < s->min_ns)
+		s->min_ns = ns;
+	if(ns > s->max_ns)
+		s->max_ns = ns;
+	s->total_ns += ns;
+	s->n++;
+}
+
+// virtual time as ms.us, for the trace
+const char *sim_stamp(void) {
+	static char s[32];
+	u64 us = sim_cycles / (FMCK_HZ / 1000000);
+
+	snprintf(s, sizeof(s), "%llu.%03llu", (unsigned long long)(us / 1000), (unsigned long long)(us % 1000));
+	return s;
+}
+
+// COUNT register: virtual time plus host time spent since the last tick
+u32 sim_sys_count(void) {
+	if(exact)
+		return sim_cycles;
+	return sim_cycles + (sim_ns() - tick_ns) * (FMCK_HZ / 1000000) / 1000;
+}
+
+static void stat_print(const sim_stat_t *s) {
+	if(s->n == 0)
+		printf("  %-10s %10s\n", s->name, "-");
+	else
+		printf("  %-10s %10llu calls  min %6llu  avg %6llu  max %6llu ns\n", s->name,
+			(unsigned long long)s->n, (unsigned long long)s->min_ns,
+			(unsigned long long)(s->total_ns / s->n), (unsigned long long)s->max_ns);
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// wrappers around the firmware entry points
+
+static void wrap_clock(u8 phase) {
+	u64 t = sim_ns();
+	(*fw_clock)(phase);
+	sim_stat_add(phase ? &stat_clock_hi : &stat_clock_lo, sim_ns() - t);
+}
+
+static void wrap_clock_ext(s32 data) {
+	u64 t = sim_ns();
+	(*fw_clock_ext)(data);
+	sim_stat_add(data ? &stat_clock_hi : &stat_clock_lo, sim_ns() - t);
+}
+
+static void wrap_grid_key(s32 data) {
+	u64 t = sim_ns();
+	(*fw_grid_key)(data);
+	sim_stat_add(&stat_grid_key, sim_ns() - t);
+}
+
+static void wrap_refresh(s32 data) {
+	u64 t = sim_ns();
+	(*fw_refresh)(data);
+	sim_stat_add(&stat_refresh, sim_ns() - t);
+	// a held frame goes out on a later refresh
+	if(!frame_pending)
+		sim_monome_check();
+}
+
+static void wrap_ii(uint8_t *data, uint8_t l) {
+	u64 t = sim_ns();
+	(*fw_ii)(data, l);
+	sim_stat_add(&stat_ii, sim_ns() - t);
+	sim_out.ii++;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// stimulus
+
+#define MAX_HELD 8
+
+typedef struct {
+	u8 x, y;
+	u64 release;
+} held_t;
+
+static held_t held[MAX_HELD];
+static u8 held_count;
+static u32 prng;
+
+static u32 sim_rand(void) {
+	// xorshift32, independent of the firmware's rnd()
+	prng ^= prng << 13;
+	prng ^= prng >> 17;
+	prng ^= prng << 5;
+	return prng;
+}
+
+static void post_key(u8 x, u8 y, u8 z) {
+	sim_monome_key(x, y, z);
+	sim_out.keys++;
+
+	if(keys_out)
+		fprintf(keys_out, "%llu %u %u %u\n", (unsigned long long)sim_ms, x, y, z);
+}
+
+static void keys_generate(void) {
+	u8 i, x, y, grid_x = monome_size_x();
+
+	for(i = 0; i < held_count; ) {
+		if(held[i].release <= sim_ms) {
+			post_key(held[i].x, held[i].y, 0);
+			held[i] = held[--held_count];
+		}
+		else i++;
+	}
+
+	if(key_rate == 0 || held_count == MAX_HELD || sim_rand() % 1000 >= key_rate)
+		return;
+
+	x = sim_rand() % grid_x;
+	y = sim_rand() % 8;
+	for(i = 0; i < held_count; i++)
+		if(held[i].x == x && held[i].y == y)
+			return;
+
+	held[held_count].x = x;
+	held[held_count].y = y;
+	// mostly short presses, some long enough to count as a hold
+	held[held_count].release = sim_ms + 20 + sim_rand() % (sim_rand() & 1 ? 150 : 900);
+	held_count++;
+	post_key(x, y, 1);
+}
+
+static void keys_replay(void) {
+	static unsigned long long t;
+	static unsigned x, y, z;
+	static int pending;
+
+	for(;;) {
+		if(!pending) {
+			if(fscanf(keys_in, "%llu %u %u %u", &t, &x, &y, &z) != 4)
+				return;
+			pending = 1;
+		}
+		if(t > sim_ms)
+			return;
+		post_key(x, y, z);
+		pending = 0;
+	}
+}
+
+static void front(void) {
+	event_t e;
+
+	if(front_ms == 0)
+		return;
+	if(sim_ms % front_ms == 0 || sim_ms % front_ms == 1000) {
+		e.type = kEventFront;
+		e.data = sim_ms % front_ms != 0;
+		event_post(&e);
+	}
+}
+
+static void ii_preset(void) {
+	static u8 n;
+	u8 d[3];
+
+	if(ii_ms == 0 || sim_ms % ii_ms)
+		return;
+	n++;
+	d[0] = WW_PRESET;
+	d[1] = 0;
+	d[2] = n & 7;
+	(*process_ii)(d, 3);
+}
+
+// the cpu is held up, as by a flash page write: time moves on without it
+void sim_stall(u32 us) {
+	sim_cycles += (u64)us * (FMCK_HZ / 1000000);
+}
+
+static void clock_ext(void) {
+	event_t e;
+
+	if(ext_ms == 0)
+		return;
+	if(sim_ms % ext_ms == 0 || sim_ms % ext_ms == ext_ms / 2) {
+		e.type = kEventClockExt;
+		e.data = sim_ms % ext_ms == 0;
+		event_post(&e);
+	}
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// report
+
+static void report(void) {
+	double s = sim_ms / 1000.;
+
+	if(keys_out)
+		fclose(keys_out);
+	if(sim_trace)
+		fclose(sim_trace);
+
+	printf("\r\n\n// sim: %.1f s simulated, %s clock\n", s, ext_ms ? "external" : "internal");
+	printf("  clock edges %llu, dac writes %llu (A changed %llu, B changed %llu)\n",
+		(unsigned long long)sim_out.clock_edges, (unsigned long long)sim_out.dac_writes,
+		(unsigned long long)sim_out.dac_changes[0], (unsigned long long)sim_out.dac_changes[1]);
+	printf("  triggers %llu %llu %llu %llu\n",
+		(unsigned long long)sim_out.tr_edges[0], (unsigned long long)sim_out.tr_edges[1],
+		(unsigned long long)sim_out.tr_edges[2], (unsigned long long)sim_out.tr_edges[3]);
+	printf("  grid keys %llu, ii %llu\n",
+		(unsigned long long)sim_out.keys, (unsigned long long)sim_out.ii);
+	printf("  led frames %llu: maps %llu, rows %llu, leds %llu, %.0f bytes/s, %llu wrong\n",
+		(unsigned long long)sim_out.led_frames, (unsigned long long)sim_out.led_maps,
+		(unsigned long long)sim_out.led_rows, (unsigned long long)sim_out.led_sets,
+		s > 0 ? sim_out.led_bytes / s : 0., (unsigned long long)sim_out.led_mismatches);
+	printf("\n");
+	stat_print(&stat_clock_hi);
+	stat_print(&stat_clock_lo);
+	stat_print(&stat_grid_key);
+	stat_print(&stat_refresh);
+	stat_print(&stat_ii);
+
+	clock_print_stats();
+	frame_print_stats();
+	refresh_print_stats();
+	queue_print_stats();
+	store_print_stats();
+	journal_print_stats();
+	flash_print_stats();
+	printf("\n");
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// setup and tick
+
+static u32 env(const char *name, u32 def) {
+	const char *s = getenv(name);
+	return s ? strtoul(s, NULL, 0) : def;
+}
+
+__attribute__((constructor))
+static void sim_setup(void) {
+	const char *s;
+
+	run_ms = env("SIM_MS", run_ms);
+	seed = env("SIM_SEED", seed);
+	key_rate = env("SIM_RATE", key_rate);
+	ext_ms = env("SIM_EXT", 0);
+	sim_adc[0] = env("SIM_TEMPO", 2048);
+	sim_adc[1] = env("SIM_PARAM", 2048);
+	step_lookahead = env("SIM_LOOKAHEAD", 1);
+	exact = env("SIM_EXACT", 0);
+	front_ms = env("SIM_FRONT", 0);
+	ii_ms = env("SIM_II", 0);
+	sim_flash_us = env("SIM_FLASH_US", 4000);
+	sim_flash_cut = env("SIM_CUT", 0);
+	sim_nvram = getenv("SIM_NVRAM");
+	prng = seed ? seed : 1;
+
+	if((s = getenv("SIM_KEYS")) && !(keys_in = fopen(s, "r"))) {
+		perror(s);
+		exit(1);
+	}
+	if((s = getenv("SIM_RECORD")) && !(keys_out = fopen(s, "w"))) {
+		perror(s);
+		exit(1);
+	}
+	if((s = getenv("SIM_TRACE")) && !(sim_trace = fopen(s, "w"))) {
+		perror(s);
+		exit(1);
+	}
+
+	tick_ns = sim_ns();
+	sim_hal_init();
+	if(ext_ms)
+		sim_pin_set(B09, 0);	// jack patched
+}
+
+static void sim_start(void) {
+	event_t e;
+
+	fw_clock = clock_pulse;
+	clock_pulse = &wrap_clock;
+	fw_ii = process_ii;
+	process_ii = &wrap_ii;
+	fw_grid_key = app_event_handlers[kEventMonomeGridKey];
+	app_event_handlers[kEventMonomeGridKey] = &wrap_grid_key;
+	fw_refresh = app_event_handlers[kEventMonomeRefresh];
+	app_event_handlers[kEventMonomeRefresh] = &wrap_refresh;
+	fw_clock_ext = app_event_handlers[kEventClockExt];
+	app_event_handlers[kEventClockExt] = &wrap_clock_ext;
+
+	sim_monome_connect(env("SIM_GRID", 16), !env("SIM_MONO", 0));
+	e.type = kEventMonomeConnect;
+	e.data = 0;
+	event_post(&e);
+}
+
+// firmware is idle: advance the virtual clock to the next timer/counter
+// interrupt or millisecond tick, whichever comes first
+void sim_idle(void) {
+	static u8 started;
+	static u64 next_tick = FMCK_HZ / 1000;
+	u64 next_tc;
+
+	if(!started) {
+		started = 1;
+		sim_start();
+		return;
+	}
+
+	// after a stall the interrupts that fell due in it run late, in order
+	next_tc = sim_tc_next();
+	if(next_tc < next_tick) {
+		if(next_tc > sim_cycles)
+			sim_cycles = next_tc;
+		tick_ns = sim_ns();
+		sim_tc_fire();
+		sim_sync();
+		return;
+	}
+
+	if(sim_ms >= run_ms) {
+		report();
+		exit(0);
+	}
+
+	sim_ms++;
+	if(next_tick > sim_cycles)
+		sim_cycles = next_tick;
+	next_tick += FMCK_HZ / 1000;
+	tick_ns = sim_ns();
+
+	if(keys_in)
+		keys_replay();
+	else
+		keys_generate();
+	clock_ext();
+	front();
+	ii_preset();
+
+	process_timers();
+	sim_sync();
+}
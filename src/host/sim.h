@@ -0,0 +1,78 @@
+#ifndef _SIM_H_
+#define _SIM_H_
+
+// host simulation of the trilogy hardware.
+//
+// the firmware's own main loop drives the simulation: whenever the event
+// queue runs dry, event_next() hands control to sim_idle(), which advances
+// the virtual clock by one timer tick, fires the soft timers and injects
+// any scheduled grid, clock or pot input.
+
+#include <stdio.h>
+
+#include "types.h"
+
+// virtual clock, in cpu cycles at FMCK_HZ
+extern u64 sim_cycles;
+extern u64 sim_ms;
+
+// optional trace of every output change, for regression diffs
+extern FILE *sim_trace;
+extern const char *sim_stamp(void);
+
+// per-call host timing of the hot firmware paths
+typedef struct {
+	const char *name;
+	u64 n;
+	u64 total_ns;
+	u64 min_ns;
+	u64 max_ns;
+} sim_stat_t;
+
+extern u64 sim_ns(void);
+extern void sim_stat_add(sim_stat_t *s, u64 ns);
+
+// recorded outputs
+typedef struct {
+	u64 dac_writes;
+	u64 dac_changes[2];
+	u16 dac[2];
+	u64 tr_edges[4];
+	u64 clock_edges;
+	u64 led_frames;
+	u64 led_maps;
+	u64 led_rows;
+	u64 led_sets;
+	u64 led_bytes;
+	u64 led_mismatches;
+	u64 keys;
+	u64 ii;
+} sim_out_t;
+
+extern sim_out_t sim_out;
+
+// hal.c
+extern void sim_hal_init(void);
+extern u16 sim_adc[4];
+extern void sim_pin_set(u32 pin, int value);
+extern int sim_pin_get(u32 pin);
+extern void sim_sync(void);
+extern u64 sim_tc_next(void);
+extern void sim_tc_fire(void);
+
+// monome.c
+extern u8 sim_grid[128];
+extern void sim_monome_connect(u8 size_x, u8 vari);
+extern void sim_monome_write(const u8 *data, u32 bytes);
+extern void sim_monome_check(void);
+extern void sim_monome_key(u8 x, u8 y, u8 z);
+extern u8 sim_monome_rx(void);
+
+// sim.c
+extern u32 sim_flash_us;
+extern u32 sim_flash_cut;
+extern const char *sim_nvram;
+extern void sim_idle(void);
+extern void sim_stall(u32 us);
+
+#endif
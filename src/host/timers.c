@@ -0,0 +1,71 @@
+// host version of the libavr32 soft timer list
+
+#include "timers.h"
+
+static softTimer_t *head = NULL;
+
+bool timer_add(softTimer_t *t, u32 ticks, timer_callback_t callback, void *caller) {
+	softTimer_t *p;
+
+	for(p = head; p; p = p->next)
+		if(p == t)
+			return false;
+
+	t->ticks = ticks;
+	t->ticksRemain = ticks;
+	t->callback = callback;
+	t->caller = caller;
+	t->prev = NULL;
+	t->next = head;
+	if(head)
+		head->prev = t;
+	head = t;
+	return true;
+}
+
+bool timer_remove(softTimer_t *t) {
+	softTimer_t *p;
+
+	for(p = head; p; p = p->next)
+		if(p == t)
+			break;
+	if(!p)
+		return false;
+
+	if(t->prev)
+		t->prev->next = t->next;
+	else
+		head = t->next;
+	if(t->next)
+		t->next->prev = t->prev;
+	t->next = t->prev = NULL;
+	return true;
+}
+
+void timer_set(softTimer_t *t, u32 ticks) {
+	t->ticks = ticks;
+	if(t->ticksRemain > ticks)
+		t->ticksRemain = ticks;
+}
+
+void timer_reset(softTimer_t *t) {
+	t->ticksRemain = t->ticks;
+}
+
+void timer_reset_set(softTimer_t *t, u32 ticks) {
+	t->ticks = ticks;
+	t->ticksRemain = ticks;
+}
+
+// called once per millisecond tick, like the tc interrupt on hardware
+void process_timers(void) {
+	softTimer_t *t, *next;
+
+	for(t = head; t; t = next) {
+		next = t->next;
+		if(--t->ticksRemain == 0) {
+			t->ticksRemain = t->ticks;
+			(*t->callback)(t->caller);
+		}
+	}
+}
@@ -0,0 +1,522 @@
+// preset journal.
+//
+// presets are never rewritten in place. each save appends a record to a
+// ring in flash: the data, then a header carrying a sequence number, the
+// preset slot and crcs of both. the header goes in last, so a record only
+// counts once it is complete, and a save cut short by a power loss leaves
+// the slot's previous record as its newest valid one. at boot the ring is
+// scanned for the newest valid record of each slot.
+//
+// a save costs what it changed. pages that match the slot as it stands
+// make a save with nothing changed a no-op, and otherwise the record is a
+// delta: only the pages that differ from the slot's last full record, so
+// a few edits program a page or two and the header. a slot's live delta
+// keeps its full record live as well. a save that changes every page, or
+// one that would leave too few records free for tidying, is written full.
+//
+// in idle time the ring is tidied: live records just ahead of the head
+// are moved to it, so writing keeps sweeping the whole ring rather than
+// wearing the few records around the presets that never change, and the
+// record at the head is erased, so a save only has to program.
+//
+// one save can wait behind the record being written; it starts when that
+// one is done, and a newer save replaces it. until then reads of its slot
+// come from its data, so nothing ever has to wait for the flash.
+
+#include <stddef.h>
+#include <string.h>
+
+#include "compiler.h"
+#include "cycle_counter.h"
+#include "flashc.h"
+#include "print_funcs.h"
+
+#include "journal.h"
+
+#define JOURNAL_MAGIC 0x77686c32
+// records kept clear of live ones, counting the head itself, which
+// next_free() never leaves on a live record
+#define JOURNAL_GAP 3
+// live records a save may leave; past this it writes a full record, which
+// frees the slot's old full record and delta
+#define JOURNAL_LIVE_MAX (JOURNAL_RECORDS - JOURNAL_GAP - 1)
+
+typedef enum {
+	jobNone, jobAppend, jobMove
+} journal_job;
+
+// not const, so reads aren't folded into the zeros it's declared with
+__attribute__((__section__(".flash_nvram")))
+__attribute__((aligned(STORE_PAGE)))
+u8 journal_flash[JOURNAL_RECORDS][JOURNAL_BYTES];
+
+// record holding each slot's newest, the full record it builds on (the
+// same one unless newest is a delta), and the next record to write
+static u8 live[JOURNAL_SLOTS];
+static u8 full[JOURNAL_SLOTS];
+static u8 head;
+static u32 seq;
+static u32 erased;
+static u8 erase_page;
+
+// the record being written, what it was moved from, and the save waiting
+// for it
+static journal_job job;
+static u8 job_slot, job_record, job_from;
+static const void *job_data;
+static journal_head staged;
+static u8 queued_slot = JOURNAL_NONE;
+static const void *queued_data;
+static u16 queued_bytes;
+
+static u32 appends, deltas, unchanged, moves, erases;
+static u8 scan_valid, scan_bad;
+
+
+static u32 crc32(u32 crc, const u8 *p, u32 n) {
+	static const u32 nibble[16] = {
+		0x00000000, 0x1db71064, 0x3b6e20c8, 0x26d930ac,
+		0x76dc4190, 0x6b6b51f4, 0x4db26158, 0x5005713c,
+		0xedb88320, 0xf00f9344, 0xd6d6a3e8, 0xcb61b38c,
+		0x9b64c2b0, 0x86d3d2d4, 0xa00ae278, 0xbdbdf21c
+	};
+
+	crc = ~crc;
+	while(n--) {
+		crc ^= *p++;
+		crc = (crc >> 4) ^ nibble[crc & 15];
+		crc = (crc >> 4) ^ nibble[crc & 15];
+	}
+	return ~crc;
+}
+
+static const journal_head *header(u8 r) {
+	return (const journal_head *)&journal_flash[r][JOURNAL_PAYLOAD];
+}
+
+static u32 head_crc(const journal_head *h) {
+	return crc32(0, (const u8 *)h, offsetof(journal_head, head_crc));
+}
+
+// data pages holding bytes, a bit each
+static u16 page_mask(u16 bytes) {
+	return (1 << ((bytes + STORE_PAGE - 1) / STORE_PAGE)) - 1;
+}
+
+// bytes of page k that hold data
+static u16 page_bytes(u8 k, u16 bytes) {
+	u16 n = bytes - k * STORE_PAGE;
+
+	return n > STORE_PAGE ? STORE_PAGE : n;
+}
+
+// header intact, whatever state the data is in
+static u8 header_valid(const journal_head *h) {
+	return h->magic == JOURNAL_MAGIC && h->slot < JOURNAL_SLOTS
+		&& h->bytes <= JOURNAL_PAYLOAD && h->head_crc == head_crc(h)
+		&& (h->base || h->pages == page_mask(h->bytes));
+}
+
+// page k of the preset made of record r over full record f
+static const u8 *page(u8 r, u8 f, u8 k) {
+	return &journal_flash[header(r)->pages & (1 << k) ? r : f][k * STORE_PAGE];
+}
+
+static u8 data_valid(u8 r, u8 f) {
+	const journal_head *h = header(r);
+	u32 crc = 0;
+	u8 k;
+
+	for(k=0;k<JOURNAL_PAGES && k * STORE_PAGE < h->bytes;k++)
+		crc = crc32(crc, page(r, f, k), page_bytes(k, h->bytes));
+	return crc == h->data_crc;
+}
+
+static u8 is_live(u8 r) {
+	u8 i;
+
+	for(i=0;i<JOURNAL_SLOTS;i++)
+		if(live[i] == r || full[i] == r)
+			return 1;
+	return 0;
+}
+
+static u8 live_count(void) {
+	u8 i, n = 0;
+
+	for(i=0;i<JOURNAL_SLOTS;i++)
+		n += (live[i] != JOURNAL_NONE) + (full[i] != live[i]);
+	return n;
+}
+
+// first record from r on that no slot depends on
+static u8 next_free(u8 r) {
+	r %= JOURNAL_RECORDS;
+	while(is_live(r))
+		r = (r + 1) % JOURNAL_RECORDS;
+	return r;
+}
+
+static u8 all_erased(u8 r) {
+	u32 i;
+
+	for(i=0;i<JOURNAL_BYTES;i++)
+		if(journal_flash[r][i] != 0xff)
+			return 0;
+	return 1;
+}
+
+// the slot's record with a good header from the latest save. by saved,
+// not seq: a full record moved on past its delta is still the older one
+static u8 newest(u32 valid, u8 slot) {
+	const journal_head *h;
+	u8 r, n = JOURNAL_NONE;
+
+	for(r=0;r<JOURNAL_RECORDS;r++) {
+		h = header(r);
+		if((valid & (1 << r)) && h->slot == slot && (n == JOURNAL_NONE
+				|| h->saved > header(n)->saved
+				|| (h->saved == header(n)->saved && h->seq > header(n)->seq)))
+			n = r;
+	}
+	return n;
+}
+
+// a good full record of the slot from the save saved
+static u8 find_full(u32 valid, u8 slot, u32 saved) {
+	u8 r;
+
+	for(r=0;r<JOURNAL_RECORDS;r++)
+		if((valid & (1 << r)) && header(r)->slot == slot && header(r)->base == 0
+				&& header(r)->saved == saved && data_valid(r, r))
+			return r;
+	return JOURNAL_NONE;
+}
+
+void journal_init(void) {
+	const journal_head *h;
+	u32 valid = 0, top = 0, left;
+	u8 r, f, i, latest = JOURNAL_NONE;
+
+	memset(live, JOURNAL_NONE, sizeof(live));
+	memset(full, JOURNAL_NONE, sizeof(full));
+	scan_valid = scan_bad = 0;
+	erased = 0;
+
+	for(r=0;r<JOURNAL_RECORDS;r++) {
+		h = header(r);
+		if(!header_valid(h)) {
+			if(all_erased(r))
+				erased |= 1 << r;
+			continue;
+		}
+		valid |= 1 << r;
+		if(latest == JOURNAL_NONE || h->seq > top) {
+			top = h->seq;
+			latest = r;
+		}
+	}
+
+	// each slot's newest record that is whole, with its full record
+	for(i=0;i<JOURNAL_SLOTS;i++) {
+		left = valid;
+		while((r = newest(left, i)) != JOURNAL_NONE) {
+			h = header(r);
+			left &= ~(1 << r);
+			f = h->base ? find_full(valid, i, h->base) : r;
+			if(f != JOURNAL_NONE && data_valid(r, f)) {
+				live[i] = r;
+				full[i] = f;
+				scan_valid++;
+				break;
+			}
+			scan_bad++;
+		}
+	}
+
+	seq = latest == JOURNAL_NONE ? 1 : top + 1;
+	head = next_free(latest == JOURNAL_NONE ? 0 : latest + 1);
+	job = jobNone;
+	erase_page = 0;
+}
+
+// whether the slot has been saved
+u8 journal_has(u8 slot) {
+	return slot < JOURNAL_SLOTS && (live[slot] != JOURNAL_NONE
+		|| queued_slot == slot || (job == jobAppend && job_slot == slot));
+}
+
+// copy part of the slot's newest data: a save still to be written, or its
+// newest valid record
+u8 journal_read(u8 slot, void *dst, u16 offset, u16 bytes) {
+	u8 *d = dst;
+	u16 n, o;
+
+	if(!journal_has(slot))
+		return 0;
+	if(queued_slot == slot)
+		memcpy(dst, (const u8 *)queued_data + offset, bytes);
+	else if(job == jobAppend && job_slot == slot)
+		memcpy(dst, (const u8 *)job_data + offset, bytes);
+	else {
+		while(bytes) {
+			o = offset % STORE_PAGE;
+			n = STORE_PAGE - o;
+			if(n > bytes)
+				n = bytes;
+			memcpy(d, page(live[slot], full[slot], offset / STORE_PAGE) + o, n);
+			d += n;
+			offset += n;
+			bytes -= n;
+		}
+	}
+	return 1;
+}
+
+// the most recently saved slot
+u8 journal_latest(void) {
+	u8 i, r = JOURNAL_NONE, slot = JOURNAL_NONE;
+
+	for(i=0;i<JOURNAL_SLOTS;i++)
+		if(live[i] != JOURNAL_NONE && (r == JOURNAL_NONE || header(live[i])->saved > header(r)->saved)) {
+			r = live[i];
+			slot = i;
+		}
+	return slot;
+}
+
+// the record is complete: a save becomes its slot's newest, a moved
+// record takes over whatever its source was to the slot
+static void finish(void) {
+	u8 s = job_slot;
+
+	if(job == jobMove) {
+		if(live[s] == job_from)
+			live[s] = job_record;
+		if(full[s] == job_from)
+			full[s] = job_record;
+	}
+	else {
+		live[s] = job_record;
+		if(staged.base == 0)
+			full[s] = job_record;
+	}
+	job = jobNone;
+	head = next_free(job_record + 1);
+	erase_page = 0;
+}
+
+// write the marked data pages, then the header, to the head record. only
+// when no job is running, as staged is its header. data is laid out as
+// the record is, so it may be another record
+static void start(journal_job j, u8 slot, const void *data, const journal_head *h) {
+	const u8 *src = data;
+	u8 k, first;
+
+	job = j;
+	job_slot = slot;
+	job_record = head;
+	job_data = data;
+
+	staged = *h;
+	staged.magic = JOURNAL_MAGIC;
+	staged.seq = seq++;
+	staged.saved = h->saved ? h->saved : staged.seq;
+	staged.slot = slot;
+	staged.pad = 0;
+	staged.head_crc = head_crc(&staged);
+
+	store_begin(!(erased & (1 << head)));
+	// runs of marked pages, a copy each
+	for(k=0;k<JOURNAL_PAGES;k++) {
+		if(!(h->pages & (1 << k)))
+			continue;
+		first = k;
+		while(k + 1 < JOURNAL_PAGES && (h->pages & (1 << (k + 1))))
+			k++;
+		store_add(&journal_flash[head][first * STORE_PAGE], src + first * STORE_PAGE,
+			(k - first) * STORE_PAGE + page_bytes(k, h->bytes));
+	}
+	store_add((void *)header(head), &staged, sizeof(staged));
+	erased &= ~(1 << head);
+	erase_page = 0;
+
+	if(!store_busy())
+		finish();
+}
+
+// write the pages that differ from the slot's full record, all of them if
+// that is every page or the ring is short of free records; or nothing, if
+// the slot already holds the data
+static void append(u8 slot, const void *data, u16 bytes) {
+	const u8 *src = data;
+	journal_head h;
+	u16 all = page_mask(bytes), changed = 0, n;
+	u8 k, r = live[slot], f = full[slot];
+
+	memset(&h, 0, sizeof(h));
+	h.bytes = bytes;
+	h.data_crc = crc32(0, data, bytes);
+	h.pages = all;
+
+	if(r != JOURNAL_NONE && header(r)->bytes == bytes) {
+		for(k=0;k<JOURNAL_PAGES && (all & (1 << k));k++) {
+			n = page_bytes(k, bytes);
+			if(memcmp(src + k * STORE_PAGE, page(r, f, k), n))
+				changed |= 1 << k;
+			if(memcmp(src + k * STORE_PAGE, &journal_flash[f][k * STORE_PAGE], n) == 0)
+				h.pages &= ~(1 << k);
+		}
+		if(changed == 0) {
+			unchanged++;
+			store_pages = 0;
+			return;
+		}
+		// a delta adds a record only if the slot had none
+		if(h.pages != all && (r != f || live_count() < JOURNAL_LIVE_MAX)) {
+			h.base = header(f)->saved;
+			deltas++;
+		}
+		else
+			h.pages = all;
+	}
+
+	appends++;
+	start(jobAppend, slot, data, &h);
+}
+
+// start saving a slot, or queue it behind the record being written, in
+// place of any save already queued. data must stay put until
+// journal_uses() lets go of it
+void journal_append(u8 slot, const void *data, u16 bytes) {
+	if(slot >= JOURNAL_SLOTS || bytes > JOURNAL_PAYLOAD)
+		return;
+	if(job != jobNone) {
+		queued_slot = slot;
+		queued_data = data;
+		queued_bytes = bytes;
+	}
+	else
+		append(slot, data, bytes);
+}
+
+// the queued save, once the running record is done
+static void unqueue(void) {
+	u8 slot = queued_slot;
+
+	if(job != jobNone || slot == JOURNAL_NONE)
+		return;
+	queued_slot = JOURNAL_NONE;
+	append(slot, queued_data, queued_bytes);
+}
+
+// whether the record being written still reads from data. a queued
+// save's data may be staged over, as long as it is then appended again
+u8 journal_uses(const void *data) {
+	return job == jobAppend && job_data == data;
+}
+
+// the first live record in the gap, if any. the head is free, so only
+// the records after it are looked at
+static u8 in_gap(void) {
+	u8 i, r;
+
+	for(i=1;i<JOURNAL_GAP;i++) {
+		r = (head + i) % JOURNAL_RECORDS;
+		if(is_live(r))
+			return r;
+	}
+	return JOURNAL_NONE;
+}
+
+static u8 tidy_needed(void) {
+	return in_gap() != JOURNAL_NONE || !(erased & (1 << head));
+}
+
+u8 journal_busy(void) {
+	return job != jobNone || tidy_needed();
+}
+
+u8 journal_saving(void) {
+	return job == jobAppend || queued_slot != JOURNAL_NONE;
+}
+
+// one page of whatever is pending: the current record, then tidying.
+// returns the cycles it took, 0 if there was nothing to do
+u32 journal_step(void) {
+	u32 t;
+	u8 r;
+
+	if(job != jobNone) {
+		t = store_page();
+		if(!store_busy()) {
+			finish();
+			unqueue();
+		}
+		return t;
+	}
+
+	r = in_gap();
+	if(r != JOURNAL_NONE) {
+		moves++;
+		job_from = r;
+		start(jobMove, header(r)->slot, journal_flash[r], header(r));
+		return job != jobNone ? journal_step() : 0;
+	}
+
+	if(!(erased & (1 << head))) {
+		t = Get_sys_count();
+		flashc_memset8(&journal_flash[head][erase_page * STORE_PAGE], 0xff, STORE_PAGE, true);
+		t = Get_sys_count() - t;
+		erases++;
+		if(++erase_page == JOURNAL_PAGES) {
+			erased |= 1 << head;
+			erase_page = 0;
+		}
+		return t;
+	}
+
+	return 0;
+}
+
+// finish every save now, stalling for as long as it takes
+void journal_flush(void) {
+	while(job != jobNone || queued_slot != JOURNAL_NONE) {
+		store_flush();
+		if(job != jobNone)
+			finish();
+		unqueue();
+	}
+}
+
+void journal_print_stats(void) {
+	u8 i, n = 0;
+
+	for(i=0;i<JOURNAL_SLOTS;i++)
+		n += live[i] != JOURNAL_NONE;
+
+	print_dbg("\r\njournal presets ");
+	print_dbg_ulong(n);
+	print_dbg(" records ");
+	print_dbg_ulong(live_count());
+	print_dbg(" seq ");
+	print_dbg_ulong(seq);
+	print_dbg(" head ");
+	print_dbg_ulong(head);
+	print_dbg(" scanned ");
+	print_dbg_ulong(scan_valid);
+	print_dbg(" bad ");
+	print_dbg_ulong(scan_bad);
+	print_dbg(" appends ");
+	print_dbg_ulong(appends);
+	print_dbg(" deltas ");
+	print_dbg_ulong(deltas);
+	print_dbg(" unchanged ");
+	print_dbg_ulong(unchanged);
+	print_dbg(" moves ");
+	print_dbg_ulong(moves);
+	print_dbg(" page erases ");
+	print_dbg_ulong(erases);
+
+	appends = deltas = unchanged = moves = erases = 0;
+}
@@ -0,0 +1,45 @@
+#ifndef _JOURNAL_H_
+#define _JOURNAL_H_
+
+#include "types.h"
+#include "store.h"
+
+// records are page aligned, JOURNAL_PAGES pages each, in a ring
+#define JOURNAL_RECORDS 16
+#define JOURNAL_PAGES 8
+#define JOURNAL_BYTES (JOURNAL_PAGES * STORE_PAGE)
+#define JOURNAL_SLOTS 8
+#define JOURNAL_NONE 0xff
+
+// seq orders records, saved is the seq of the save a moved record came
+// from. a full record has base 0; a delta holds only the data pages set in
+// pages, and takes the rest from the full record whose saved is base.
+// data_crc covers the whole preset either way
+typedef struct {
+	u32 magic;
+	u32 seq, saved;
+	u32 base;
+	u16 slot, bytes;
+	u16 pages, pad;
+	u32 data_crc;
+	u32 head_crc;
+} journal_head;
+
+#define JOURNAL_PAYLOAD (JOURNAL_BYTES - sizeof(journal_head))
+
+// the flash behind the ring; the host sim loads and saves it
+extern u8 journal_flash[JOURNAL_RECORDS][JOURNAL_BYTES];
+
+extern void journal_init(void);
+extern u8 journal_has(u8 slot);
+extern u8 journal_read(u8 slot, void *dst, u16 offset, u16 bytes);
+extern u8 journal_latest(void);
+extern void journal_append(u8 slot, const void *data, u16 bytes);
+extern u8 journal_uses(const void *data);
+extern u8 journal_busy(void);
+extern u8 journal_saving(void);
+extern u32 journal_step(void);
+extern void journal_flush(void);
+extern void journal_print_stats(void);
+
+#endif
@@ -0,0 +1,55 @@
+// latency probes.
+//
+// a probe collects cycle counter intervals between two points on one
+// path, keeping min, average, max and a log2 histogram in microseconds,
+// so a rare slow case shows up even when the average looks fine. adding
+// a sample is a handful of instructions and safe to do from an interrupt;
+// printing clears the probe so each dump covers the time since the last.
+
+#include "compiler.h"
+#include "cycle_counter.h"
+#include "print_funcs.h"
+
+#include "conf_board.h"
+#include "latency.h"
+
+
+void latency_add(latency_t *l, u32 cycles) {
+	u32 us = cycles / (FMCK_HZ / 1000000);
+	u8 b = 0;
+
+	while(us && b < LATENCY_BUCKETS - 1) {
+		us >>= 1;
+		b++;
+	}
+
+	if(l->n == 0 || cycles < l->min) l->min = cycles;
+	if(cycles > l->max) l->max = cycles;
+	l->sum += cycles;
+	l->n++;
+	l->bucket[b]++;
+}
+
+void latency_print(latency_t *l) {
+	u8 i;
+
+	print_dbg("\r\n");
+	print_dbg(l->name);
+	print_dbg(" (us) n ");
+	print_dbg_ulong(l->n);
+	print_dbg(" min ");
+	print_dbg_ulong(cpu_cy_2_us(l->min, FMCK_HZ));
+	print_dbg(" avg ");
+	print_dbg_ulong(l->n ? cpu_cy_2_us(l->sum / l->n, FMCK_HZ) : 0);
+	print_dbg(" max ");
+	print_dbg_ulong(cpu_cy_2_us(l->max, FMCK_HZ));
+	print_dbg(" <2^n:");
+	for(i=0;i<LATENCY_BUCKETS;i++) {
+		print_dbg(" ");
+		print_dbg_ulong(l->bucket[i]);
+		l->bucket[i] = 0;
+	}
+
+	l->n = l->min = l->max = 0;
+	l->sum = 0;
+}
@@ -0,0 +1,20 @@
+#ifndef _LATENCY_H_
+#define _LATENCY_H_
+
+#include "types.h"
+
+// bucket 0 counts samples under 1 us, bucket n those under 2^n us and
+// the last one everything slower
+#define LATENCY_BUCKETS 12
+
+typedef struct {
+	const char *name;
+	u32 n, min, max;
+	u64 sum;
+	u32 bucket[LATENCY_BUCKETS];
+} latency_t;
+
+extern void latency_add(latency_t *l, u32 cycles);
+extern void latency_print(latency_t *l);
+
+#endif
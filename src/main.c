@@ -1,14 +1,11 @@
-/* issues
-
-- preset save blip with internal timer vs ext trig
-
-*/
-
+#include <stddef.h>
 #include <stdio.h>
+#include <string.h>
 
 // asf
 #include "delay.h"
 #include "compiler.h"
+#include "cycle_counter.h"
 #include "flashc.h"
 #include "preprocessor.h"
 #include "print_funcs.h"
@@ -32,11 +29,27 @@
 
 // this
 #include "conf_board.h"
+#include "dac.h"
+#include "extclock.h"
+#include "frame.h"
+#include "bits.h"
+#include "gate.h"
+#include "hold.h"
+#include "journal.h"
+#include "latency.h"
+#include "queue.h"
+#include "random.h"
+#include "store.h"
+#include "tempo.h"
 #include "ii.h"
 	
 
 #define FIRSTRUN_KEY 0x22
 
+// hold times for a long press, and for the front button to save
+#define KEY_HOLD_MS 500
+#define FRONT_HOLD_MS 750
+
 
 const u16 SCALES[24][16] = {
 
@@ -105,6 +118,8 @@ typedef struct {
 	u8 cv_mute[2];
 } whale_set;
 
+// the fixed layout presets were saved in before the journal. only read,
+// to carry presets over the first time the journal is empty
 typedef const struct {
 	u8 fresh;
 	edit_modes edit_mode;
@@ -113,42 +128,226 @@ typedef const struct {
 	whale_set w[8];
 } nvram_data_t;
 
-whale_set w;
+// a journal record: one preset, with the settings current when it was saved
+typedef struct {
+	whale_set w;
+	u8 glyph[8];
+	u8 preset_select;
+	u8 edit_mode;
+} preset_record;
 
-u8 preset_mode, preset_select, front_timer;
+// fails to compile if a preset outgrows a record
+typedef char preset_record_fits[sizeof(preset_record) <= JOURNAL_PAYLOAD ? 1 : -1];
+
+// playing state of one step; the lookahead engine resolves the next step
+// into a copy of this while the clock is low
+typedef struct {
+	u8 pattern, next_pattern, pattern_jump;
+	u8 series_pos, series_next, series_jump, series_playing, series_step;
+	s8 pos, cut_pos, next_pos, drunk_step, triggered;
+	u8 tr_fired, pattern_end;
+	u8 cv_chosen[2];
+	u16 cv0, cv1;
+	ping_direction ping_dir[16];
+	random_t rnd_pattern[16], rnd_series;
+} play_state;
+
+// the playing preset and a spare the next one is fetched into, so that
+// switching presets is a pointer swap clock() can make on a step
+whale_set sets[2];
+whale_set *w = &sets[0];
+
+// a fetched preset waiting for the playing pattern to end
+#define PRESET_NONE 0xff
+volatile u8 preset_next = PRESET_NONE;
+
+u8 preset_mode, preset_select;
 u8 glyph[8];
 
 edit_modes edit_mode;
 u8 edit_cv_step, edit_cv_ch;
 s8 edit_cv_value;
 u8 edit_prob, live_in, scale_select;
-u8 pattern, next_pattern, pattern_jump, ping_pattern_jump;
+u8 pattern, next_pattern, pattern_jump;
 
 u8 series_pos, series_next, series_jump, series_playing, scroll_pos;
 
 u8 key_alt, key_meta, center;
-u8 held_keys[32], key_count, key_times[256];
 u8 keyfirst_pos, keysecond_pos;
 s8 keycount_pos, keycount_series, keycount_cv;
 
 s8 pos, cut_pos, next_pos, drunk_step, triggered;
+u8 tr_fired, pattern_end;
 u8 cv_chosen[2];
 u16 cv0, cv1;
 
+// random streams: one per pattern so each replays the same choices from
+// its seed regardless of the others, plus series and edit streams
+random_t rnd_pattern[16], rnd_series, rnd_edit;
+
+u8 step_lookahead = 1;
+play_state ahead;
+volatile u8 ahead_valid, step_editing;
+// whether ahead was resolved from a preset due to take over on its edge
+u8 ahead_switch;
+u32 step_period;
+u32 edge_count, edge_min, edge_max;
+u64 edge_total;
+
+// latency probes: clock edge to the end of clock(), and grid key from the
+// ftdi read to its handler finishing and to the frame that shows it
+u32 clock_edge_at, key_read_at, key_led_at;
+u8 key_led_pending;
+latency_t lat_clock = { "edge to clock end" };
+latency_t lat_key = { "key read to handled" };
+latency_t lat_key_led = { "key read to leds" };
+latency_t lat_load = { "preset load" };
+
 u8 param_accept, *param_dest8;
 u16 clip;
 u16 *param_dest;
 u8 quantize_in;
 
 u8 clock_phase;
-u16 clock_time, clock_temp;
+u16 clock_temp;
+
+// with a clock patched, the clock pot no longer sets the tempo but picks
+// one of these zones: multiply, divide. ext_zone is the zone applied, none
+// until the pot is first read after patching
+#define EXT_RATIOS 7
+#define EXT_ZONE (1024 / EXT_RATIOS + 1)
+#define EXT_NONE 0xff
+const u8 ext_ratio[EXT_RATIOS][2] = {
+	{1, 4}, {1, 3}, {1, 2}, {1, 1}, {2, 1}, {3, 1}, {4, 1}
+};
+u8 ext_zone = EXT_NONE;
 u8 series_step;
 
 u16 adc[4];
 u8 SIZE, LENGTH, VARI;
 
-typedef void(*re_t)(void);
-re_t re;
+// grid rows needing a redraw, one bit per row. state changes mark the rows
+// that show them; refresh redraws only those and frame_send() sends only
+// the leds that changed.
+#define GRID_TOP 0x01		// mode, mutes, triggers, cv
+#define GRID_POS 0x02		// position, loop, cut
+#define GRID_PATTERN 0x04	// pattern; first series row in series mode
+#define GRID_EDIT 0xf8		// probabilities and step, map or series data
+#define GRID_ALL 0xff
+#define GRID_PLAY 0x100		// only the playhead moved in the edit rows
+
+volatile u16 grid_rows;
+
+// playhead and playing note as last drawn in the edit rows
+u8 grid_pos, grid_note;
+
+// playing state the grid is drawn from. the clock changes the live state
+// from its interrupt, so each redraw works from a copy taken together with
+// the dirty rows rather than from state that can move under it.
+play_state view;
+
+// what a grid led shows. the one layout renderer paints these states and
+// the connected grid's palette turns them into levels, so varibright and
+// mono grids differ only in their palettes.
+typedef enum {
+	ledOff,
+	ledMode, ledSeriesMode,			// top row: current edit mode
+	ledAlt, ledAltHeld,
+	ledMuteOn, ledMuteOff,			// with meta held
+	ledTrig, ledGate,				// channels fired this step
+	ledCv,							// cv level meter
+	ledLoop, ledCut, ledPos,		// position row
+	ledPatternBg, ledPattern, ledPatternNext,
+	ledSeriesBar, ledSeriesRange,	// series start/end, plain and while editing
+	ledSeriesScroll, ledSeriesOn,
+	ledSeriesPlay, ledSeriesPlayOdd,
+	ledStepFired, ledStepChoice, ledStepOn, ledStepPlay,
+	ledProbFull, ledProbSome, ledCvProbSome,
+	ledProbBg, ledProbLevel,		// probability edit
+	ledMapRow, ledMapPlay, ledMapEdit,
+	ledMapCoarse, ledMapFine, ledMapStep, ledMapNote,
+	ledScaleSlot, ledScaleCursor,
+	ledPreset,
+	ledStates
+} led_state;
+
+// a state the grid can't show leaves the led as it is
+#define LED_HIDE 0xff
+
+typedef struct {
+	u8 level[ledStates];
+	// cv curve rows by how much of the row the value fills, in eighths;
+	// the second ramp is the play column
+	u8 curve[2][9];
+} led_palette;
+
+static const led_palette palette_vari = {
+	.level = {
+		[ledOff] = 0,
+		[ledMode] = 4, [ledSeriesMode] = 7,
+		[ledAlt] = 4, [ledAltHeld] = 11,
+		[ledMuteOn] = 11, [ledMuteOff] = LED_HIDE,
+		[ledTrig] = 11, [ledGate] = 7,
+		[ledCv] = 11,
+		[ledLoop] = 4, [ledCut] = 7, [ledPos] = 15,
+		[ledPatternBg] = 4, [ledPattern] = 11, [ledPatternNext] = 7,
+		[ledSeriesBar] = 4, [ledSeriesRange] = 4,
+		[ledSeriesScroll] = 4, [ledSeriesOn] = 7,
+		[ledSeriesPlay] = 11, [ledSeriesPlayOdd] = 11,
+		[ledStepFired] = 11, [ledStepChoice] = 4, [ledStepOn] = 7, [ledStepPlay] = 4,
+		[ledProbFull] = 11, [ledProbSome] = 4, [ledCvProbSome] = 7,
+		[ledProbBg] = 4, [ledProbLevel] = 7,
+		[ledMapRow] = 4, [ledMapPlay] = 7, [ledMapEdit] = 11,
+		[ledMapCoarse] = 7, [ledMapFine] = 4, [ledMapStep] = 7, [ledMapNote] = 11,
+		[ledScaleSlot] = 4, [ledScaleCursor] = 7,
+		[ledPreset] = 11
+	},
+	.curve = {
+		{ 0, 1, 2, 3, 4, 5, 6, 7, 7 },
+		{ 4, 5, 6, 7, 8, 9, 10, 11, 11 }
+	}
+};
+
+static const led_palette palette_mono = {
+	.level = {
+		[ledOff] = 0,
+		[ledMode] = 11, [ledSeriesMode] = 11,
+		[ledAlt] = 0, [ledAltHeld] = 11,
+		[ledMuteOn] = 11, [ledMuteOff] = 0,
+		[ledTrig] = LED_HIDE, [ledGate] = LED_HIDE,
+		[ledCv] = LED_HIDE,
+		[ledLoop] = LED_HIDE, [ledCut] = LED_HIDE, [ledPos] = 15,
+		[ledPatternBg] = 0, [ledPattern] = 11, [ledPatternNext] = LED_HIDE,
+		[ledSeriesBar] = 0, [ledSeriesRange] = 11,
+		[ledSeriesScroll] = LED_HIDE, [ledSeriesOn] = 11,
+		[ledSeriesPlay] = LED_HIDE, [ledSeriesPlayOdd] = 0,
+		[ledStepFired] = 11, [ledStepChoice] = 11, [ledStepOn] = 11, [ledStepPlay] = 0,
+		[ledProbFull] = 11, [ledProbSome] = 11, [ledCvProbSome] = 11,
+		[ledProbBg] = 0, [ledProbLevel] = 11,
+		[ledMapRow] = 0, [ledMapPlay] = LED_HIDE, [ledMapEdit] = 11,
+		[ledMapCoarse] = 11, [ledMapFine] = 11, [ledMapStep] = 11, [ledMapNote] = 11,
+		[ledScaleSlot] = 0, [ledScaleCursor] = 11,
+		[ledPreset] = 11
+	},
+	.curve = {
+		{ 0, 0, 0, 0, 11, 11, 11, 11, 11 },
+		{ 0, 0, 0, 0, 11, 11, 11, 11, 11 }
+	}
+};
+
+// width dependent layout of the top row
+typedef struct {
+	u8 cv_x[2], cv_w;	// keys of each cv channel
+	u8 cv_meter;		// room to show the cv levels
+	u8 cv_map;			// cv keys open the map view even with alt or meta
+} grid_layout;
+
+static const grid_layout layout16 = { { 4, 8 }, 4, 1, 0 };
+static const grid_layout layout8 = { { 4, 5 }, 1, 0, 1 };
+
+// chosen when a grid connects
+const led_palette *pal;
+const grid_layout *lay;
 
 
 // NVRAM data structure located in the flash array.
@@ -162,9 +361,16 @@ static nvram_data_t flashy;
 // prototypes
 
 static void refresh(void);
-static void refresh_mono(void);
 static void refresh_preset(void);
+static void grid_dirty(u16 rows);
 static void clock(u8 phase);
+void step_invalidate(void);
+void step_edit(void);
+void step_edit_done(void);
+void play_seed(u8 preset);
+void clock_print_stats(void);
+void refresh_print_stats(void);
+void flash_print_stats(void);
 
 // start/stop monome polling/refresh timers
 extern void timers_set_monome(void);
@@ -183,9 +389,37 @@ static void handler_ClockExt(s32 data);
 static void ww_process_ii(uint8_t *data, uint8_t l);
 
 u8 flash_is_fresh(void);
-void flash_unfresh(void);
 void flash_write(void);
-void flash_read(void);
+
+// when a preset fetched by flash_read() takes over from the playing one:
+// at once, as WW_PRESET and the preset screen's column 0 do, or when the
+// playing pattern ends, as column 1 does
+typedef enum {
+	switchNow, switchPattern
+} preset_switch;
+
+void flash_read(u8 preset, preset_switch when);
+static void glyph_load(u8 preset);
+
+// preset saves are staged and appended to the journal a page at a time
+// where one fits between clock edges, and the journal tidies itself the
+// same way. kEventSaveFlash data says which part of a save
+typedef enum {
+	saveStart, savePage, saveDone
+} save_step;
+
+// a page write until one has been timed, and how long to wait for a gap
+// before writing regardless
+#define SAVE_PAGE_US 5000
+#define SAVE_WAIT_MS 500
+
+// a save being written reads from one buffer while the next is staged in
+// the other
+preset_record saves[2];
+preset_record *save = &saves[0];
+u8 save_active, save_ticking;
+u32 save_page_cy = SAVE_PAGE_US * (FMCK_HZ / 1000000);
+u16 save_waited;
 
 
 
@@ -196,353 +430,570 @@ void flash_read(void);
 ////////////////////////////////////////////////////////////////////////////////
 // application clock code
 
-void clock(u8 phase) {
-	static u8 i1, count;
-	static u16 found[16];
+// per-mode next position. each returns whether pos ended the pattern:
+// the loop boundary for directional modes, or for modes without one,
+// having played loop_len steps in series mode.
+typedef enum {
+	stepInside, stepCounted, stepBoundary
+} step_edge;
 
-	if(phase) {
-		gpio_set_gpio_pin(B10);
+typedef step_edge(*step_fn)(void);
 
+static step_edge step_forward(void) {
+	if(pos == w->wp[pattern].loop_end) 
+		next_pos = w->wp[pattern].loop_start;
+	else if(pos >= LENGTH) next_pos = 0;
+	else next_pos++;
+	cut_pos = 0;
 
-		if(pattern_jump) {
-			pattern = next_pattern;
-			next_pos = w.wp[pattern].loop_start;
-			pattern_jump = 0;
-		}
-		// for series mode and delayed pattern change
-		if(series_jump) {
-			series_pos = series_next;
-			if(series_pos == w.series_end)
-				series_next = w.series_start;
-			else {
-				series_next++;
-				if(series_next>63)
-					series_next = w.series_start;
-			}
+	return pos == w->wp[pattern].loop_end ? stepBoundary : stepCounted;
+}
 
-			// print_dbg("\r\nSERIES next ");
-			// print_dbg_ulong(series_next);
-			// print_dbg(" pos ");
-			// print_dbg_ulong(series_pos);
+static step_edge step_reverse(void) {
+	if(pos == w->wp[pattern].loop_start)
+		next_pos = w->wp[pattern].loop_end;
+	else if(pos <= 0)
+		next_pos = LENGTH;
+	else next_pos--;
+	cut_pos = 0;
 
-			count = 0;
-			for(i1=0;i1<16;i1++) {
-				if((w.series_list[series_pos] >> i1) & 1) {
-					found[count] = i1;
-					count++;
-				}
-			}
+	return pos == w->wp[pattern].loop_start ? stepBoundary : stepCounted;
+}
 
-			if(count == 1)
-				next_pattern = found[0];
-			else {
+static step_edge step_drunk(void) {
+	drunk_step += random_range(&rnd_pattern[pattern], 3) - 1; // -1 to 1
+	if(drunk_step < -1) drunk_step = -1;
+	else if(drunk_step > 1) drunk_step = 1;
+
+	next_pos += drunk_step;
+	if(next_pos < 0) 
+		next_pos = LENGTH;
+	else if(next_pos > LENGTH) 
+		next_pos = 0;
+	else if(w->wp[pattern].loop_dir == 1 && next_pos < w->wp[pattern].loop_start)
+		next_pos = w->wp[pattern].loop_end;
+	else if(w->wp[pattern].loop_dir == 1 && next_pos > w->wp[pattern].loop_end)
+		next_pos = w->wp[pattern].loop_start;
+	else if(w->wp[pattern].loop_dir == 2 && next_pos < w->wp[pattern].loop_start && next_pos > w->wp[pattern].loop_end) {
+		if(drunk_step == 1)
+			next_pos = w->wp[pattern].loop_start;
+		else
+			next_pos = w->wp[pattern].loop_end;
+	}
+	cut_pos = 1;
 
-				next_pattern = found[rnd()%count];
-			}
+	return stepCounted;
+}
 
-			pattern = next_pattern;
-			series_playing = pattern;
-			if(w.wp[pattern].step_mode == mReverse)
-				next_pos = w.wp[pattern].loop_end;
-			else {
-				next_pos = w.wp[pattern].loop_start;
-                w.wp[pattern].ping_dir = mPingFwd;
-            }
+static step_edge step_random(void) {
+	next_pos = random_range(&rnd_pattern[pattern], w->wp[pattern].loop_len + 1) + w->wp[pattern].loop_start;
+	if(next_pos > LENGTH) next_pos -= LENGTH + 1;
+	cut_pos = 1;
 
-			series_jump = 0;
-			series_step = 0;
-		}
+	return stepCounted;
+}
 
-		pos = next_pos;
+// 12343212
+static step_edge step_ping(void) {
+	step_edge edge = stepInside;
 
-		// live param record
-		if(param_accept && live_in) {
-			param_dest = &w.wp[pattern].cv_curves[edit_cv_ch][pos];
-			w.wp[pattern].cv_curves[edit_cv_ch][pos] = adc[1];
-		}
+	if(pos == w->wp[pattern].loop_end && mPingFwd == w->wp[pattern].ping_dir) {
+		w->wp[pattern].ping_dir = mPingRev;
+		next_pos += w->wp[pattern].ping_dir;
+	}
+	else if(pos == w->wp[pattern].loop_start && mPingRev == w->wp[pattern].ping_dir) {
+		w->wp[pattern].ping_dir = mPingFwd;
+		// the turn at loop start ends the pattern
+		edge = stepBoundary;
+		next_pos += w->wp[pattern].ping_dir;
+	}
+	else if(pos >= LENGTH) next_pos = 0;
+	else next_pos += w->wp[pattern].ping_dir;
+	cut_pos = 0;
 
-		// calc next step
-		if(w.wp[pattern].step_mode == mForward) { 		// FORWARD
-			if(pos == w.wp[pattern].loop_end) 
-                next_pos = w.wp[pattern].loop_start;
-			else if(pos >= LENGTH) next_pos = 0;
-			else next_pos++;
-			cut_pos = 0;
-		}
-		else if(w.wp[pattern].step_mode == mReverse) {	// REVERSE
-			if(pos == w.wp[pattern].loop_start)
-				next_pos = w.wp[pattern].loop_end;
-			else if(pos <= 0)
-				next_pos = LENGTH;
-			else next_pos--;
-			cut_pos = 0;
-		}
-		else if(w.wp[pattern].step_mode == mDrunk) {	// DRUNK
-			drunk_step += (rnd() % 3) - 1; // -1 to 1
-			if(drunk_step < -1) drunk_step = -1;
-			else if(drunk_step > 1) drunk_step = 1;
-
-			next_pos += drunk_step;
-			if(next_pos < 0) 
-				next_pos = LENGTH;
-			else if(next_pos > LENGTH) 
-				next_pos = 0;
-			else if(w.wp[pattern].loop_dir == 1 && next_pos < w.wp[pattern].loop_start)
-				next_pos = w.wp[pattern].loop_end;
-			else if(w.wp[pattern].loop_dir == 1 && next_pos > w.wp[pattern].loop_end)
-				next_pos = w.wp[pattern].loop_start;
-			else if(w.wp[pattern].loop_dir == 2 && next_pos < w.wp[pattern].loop_start && next_pos > w.wp[pattern].loop_end) {
-				if(drunk_step == 1)
-					next_pos = w.wp[pattern].loop_start;
-				else
-					next_pos = w.wp[pattern].loop_end;
-			}
+	return edge;
+}
 
-			cut_pos = 1;
- 		}
-		else if(w.wp[pattern].step_mode == mRandom) {	// RANDOM
-			next_pos = (rnd() % (w.wp[pattern].loop_len + 1)) + w.wp[pattern].loop_start;
-			// print_dbg("\r\nnext pos:");
-			// print_dbg_ulong(next_pos);
-			if(next_pos > LENGTH) next_pos -= LENGTH + 1;
-			cut_pos = 1;
-		}
-        else if(w.wp[pattern].step_mode == mPing) {     // PING, 12343212
-            if(pos == w.wp[pattern].loop_end && mPingFwd == w.wp[pattern].ping_dir) {
-                w.wp[pattern].ping_dir = mPingRev;
-                next_pos += w.wp[pattern].ping_dir;
-            }
-            else if(pos == w.wp[pattern].loop_start && mPingRev == w.wp[pattern].ping_dir) {
-                w.wp[pattern].ping_dir = mPingFwd;
-                // set this here because this step changes the state needed to identify the switch
-                ping_pattern_jump = 1;
-                next_pos += w.wp[pattern].ping_dir;
-            }
-            else if(pos >= LENGTH) next_pos = 0;
-            else next_pos += w.wp[pattern].ping_dir;
-            cut_pos = 0;
-        }
-        else if(w.wp[pattern].step_mode == mPingRep) {     // PINGREP, 1234432112
-            if(pos == w.wp[pattern].loop_end && mPingFwd == w.wp[pattern].ping_dir) {
-                w.wp[pattern].ping_dir = mPingRev;
-            }
-            else if(pos == w.wp[pattern].loop_end && mPingRev == w.wp[pattern].ping_dir) {
-                next_pos += w.wp[pattern].ping_dir;
-            }
-            else if(pos == w.wp[pattern].loop_start && mPingRev == w.wp[pattern].ping_dir) {
-                w.wp[pattern].ping_dir = mPingFwd;
-                // set this here because this step changes the state needed to identify the switch
-                ping_pattern_jump = 1;
-            }
-            else if(pos == w.wp[pattern].loop_start && mPingFwd == w.wp[pattern].ping_dir) {
-                next_pos += w.wp[pattern].ping_dir;
-            }
-            else if(pos >= LENGTH) next_pos = 0;
-            else next_pos += w.wp[pattern].ping_dir;
-            cut_pos = 0;
-        }
+// 1234432112
+static step_edge step_ping_rep(void) {
+	step_edge edge = stepInside;
 
-        // guard against -ve next_pos from skip back
-        if (next_pos < 0) {
-            next_pos = 0;
-        }
+	if(pos == w->wp[pattern].loop_end && mPingFwd == w->wp[pattern].ping_dir) {
+		w->wp[pattern].ping_dir = mPingRev;
+	}
+	else if(pos == w->wp[pattern].loop_end && mPingRev == w->wp[pattern].ping_dir) {
+		next_pos += w->wp[pattern].ping_dir;
+	}
+	else if(pos == w->wp[pattern].loop_start && mPingRev == w->wp[pattern].ping_dir) {
+		w->wp[pattern].ping_dir = mPingFwd;
+		// the turn at loop start ends the pattern
+		edge = stepBoundary;
+	}
+	else if(pos == w->wp[pattern].loop_start && mPingFwd == w->wp[pattern].ping_dir) {
+		next_pos += w->wp[pattern].ping_dir;
+	}
+	else if(pos >= LENGTH) next_pos = 0;
+	else next_pos += w->wp[pattern].ping_dir;
+	cut_pos = 0;
 
-		// next pattern?
-		if(pos == w.wp[pattern].loop_end && w.wp[pattern].step_mode == mForward) {
-			if(edit_mode == mSeries) 
-				series_jump++;
-			else if(next_pattern != pattern)
-				pattern_jump++;
-		}
-		else if(pos == w.wp[pattern].loop_start && w.wp[pattern].step_mode == mReverse) {
-			if(edit_mode == mSeries) 
-				series_jump++;
-			else if(next_pattern != pattern)
-				pattern_jump++;
+	return edge;
+}
+
+// indexed by step_modes
+#define STEP_MODES 6
+static const step_fn step_next[STEP_MODES] = {
+	step_forward, step_reverse, step_drunk, step_random, step_ping, step_ping_rep
+};
+
+// resolve series, pattern jumps and the next position
+static void step_advance(void) {
+	static u8 count;
+	step_edge edge;
+
+	if(pattern_jump) {
+		pattern = next_pattern;
+		next_pos = w->wp[pattern].loop_start;
+		pattern_jump = 0;
+	}
+	// for series mode and delayed pattern change
+	if(series_jump) {
+		series_pos = series_next;
+		if(series_pos == w->series_end)
+			series_next = w->series_start;
+		else {
+			series_next++;
+			if(series_next>63)
+				series_next = w->series_start;
 		}
-		else if(ping_pattern_jump == 1 && (w.wp[pattern].step_mode == mPing || w.wp[pattern].step_mode == mPingRep)) {
-             if(edit_mode == mSeries) 
-                series_jump++;
-             else if(next_pattern != pattern)
-                pattern_jump++;
+
+		// print_dbg("\r\nSERIES next ");
+		// print_dbg_ulong(series_next);
+		// print_dbg(" pos ");
+		// print_dbg_ulong(series_pos);
+
+		count = bits_count(w->series_list[series_pos]);
+
+		if(count == 1)
+			next_pattern = bits_nth(w->series_list[series_pos], 0);
+		else
+			next_pattern = bits_nth(w->series_list[series_pos], random_range(&rnd_series, count));
+
+		pattern = next_pattern;
+		series_playing = pattern;
+		if(w->wp[pattern].step_mode == mReverse)
+			next_pos = w->wp[pattern].loop_end;
+		else {
+			next_pos = w->wp[pattern].loop_start;
+            w->wp[pattern].ping_dir = mPingFwd;
         }
-		else if(series_step == w.wp[pattern].loop_len && w.wp[pattern].step_mode != mPing && w.wp[pattern].step_mode != mPingRep) {
+
+		series_jump = 0;
+		series_step = 0;
+	}
+
+	pos = next_pos;
+
+	// live param record
+	if(param_accept && live_in) {
+		param_dest = &w->wp[pattern].cv_curves[edit_cv_ch][pos];
+		w->wp[pattern].cv_curves[edit_cv_ch][pos] = adc[1];
+	}
+
+	// calc next step
+	if(w->wp[pattern].step_mode < STEP_MODES)
+		edge = step_next[w->wp[pattern].step_mode]();
+	else
+		edge = stepCounted;
+
+    // guard against -ve next_pos from skip back
+    if (next_pos < 0) {
+        next_pos = 0;
+    }
+
+	// next pattern?
+	pattern_end = 0;
+	if(edge == stepBoundary) {
+		if(edit_mode == mSeries) 
 			series_jump++;
-		}
-        // reset this
-        ping_pattern_jump = 0;
+		else if(next_pattern != pattern)
+			pattern_jump++;
+		pattern_end = 1;
+	}
+	else if(edge == stepCounted && series_step == w->wp[pattern].loop_len) {
+		series_jump++;
+		pattern_end = 1;
+	}
 
-		if(edit_mode == mSeries)
-			series_step++;
+	if(edit_mode == mSeries)
+		series_step++;
+}
 
+// roll probabilities and choose cv values and triggers for pos
+static void step_resolve(void) {
+	static u8 count;
 
-		// PARAM 0
-		if((rnd() % 255) < w.wp[pattern].cv_probs[0][pos] && w.cv_mute[0]) {
-			if(w.wp[pattern].cv_mode[0] == 0) {
-				cv0 = w.wp[pattern].cv_curves[0][pos];
-			}
-			else {
-				count = 0;
-				for(i1=0;i1<16;i1++)
-					if(w.wp[pattern].cv_steps[0][pos] & (1<<i1)) {
-						found[count] = i1;
-						count++;
-					}
-				if(count == 1) 
-					cv_chosen[0] = found[0];
-				else
-					cv_chosen[0] = found[rnd() % count];
-				cv0 = w.wp[pattern].cv_values[cv_chosen[0]];			
-			}
+	// PARAM 0
+	if(random_range(&rnd_pattern[pattern], 255) < w->wp[pattern].cv_probs[0][pos] && w->cv_mute[0]) {
+		if(w->wp[pattern].cv_mode[0] == 0) {
+			cv0 = w->wp[pattern].cv_curves[0][pos];
+		}
+		else {
+			count = bits_count(w->wp[pattern].cv_steps[0][pos]);
+			if(count == 1)
+				cv_chosen[0] = bits_nth(w->wp[pattern].cv_steps[0][pos], 0);
+			else
+				cv_chosen[0] = bits_nth(w->wp[pattern].cv_steps[0][pos], random_range(&rnd_pattern[pattern], count));
+			cv0 = w->wp[pattern].cv_values[cv_chosen[0]];			
 		}
+	}
 
-		// PARAM 1
-		if((rnd() % 255) < w.wp[pattern].cv_probs[1][pos] && w.cv_mute[1]) {
-			if(w.wp[pattern].cv_mode[1] == 0) {
-				cv1 = w.wp[pattern].cv_curves[1][pos];
-			}
-			else {
-				count = 0;
-				for(i1=0;i1<16;i1++)
-					if(w.wp[pattern].cv_steps[1][pos] & (1<<i1)) {
-						found[count] = i1;
-						count++;
-					}
-				if(count == 1) 
-					cv_chosen[1] = found[0];
-				else
-					cv_chosen[1] = found[rnd() % count];
+	// PARAM 1
+	if(random_range(&rnd_pattern[pattern], 255) < w->wp[pattern].cv_probs[1][pos] && w->cv_mute[1]) {
+		if(w->wp[pattern].cv_mode[1] == 0) {
+			cv1 = w->wp[pattern].cv_curves[1][pos];
+		}
+		else {
+			count = bits_count(w->wp[pattern].cv_steps[1][pos]);
+			if(count == 1)
+				cv_chosen[1] = bits_nth(w->wp[pattern].cv_steps[1][pos], 0);
+			else
+				cv_chosen[1] = bits_nth(w->wp[pattern].cv_steps[1][pos], random_range(&rnd_pattern[pattern], count));
 
-				cv1 = w.wp[pattern].cv_values[cv_chosen[1]];			
-			}
+			cv1 = w->wp[pattern].cv_values[cv_chosen[1]];			
 		}
+	}
 
+	// TRIGGER
+	triggered = 0;
+	tr_fired = random_range(&rnd_pattern[pattern], 255) < w->wp[pattern].step_probs[pos];
+	if(tr_fired) {
+		if(w->wp[pattern].step_choice & 1<<pos) {
+			count = bits_count(w->wp[pattern].steps[pos] & 0xf);
+
+			if(count == 0)
+				triggered = 0;
+			else if(count == 1)
+				triggered = 1<<bits_nth(w->wp[pattern].steps[pos] & 0xf, 0);
+			else
+				triggered = 1<<bits_nth(w->wp[pattern].steps[pos] & 0xf, random_range(&rnd_pattern[pattern], count));
+		}	
+		else {
+			triggered = w->wp[pattern].steps[pos];
+		}
+	}
+}
 
-		// write to DAC
-		spi_selectChip(DAC_SPI,DAC_SPI_NPCS);
-		// spi_write(SPI,0x39);	// update both
-		spi_write(DAC_SPI,0x31);	// update A
-		// spi_write(SPI,0x38);	// update B
-		// spi_write(SPI,pos*15);	// send position
- 		// spi_write(SPI,0);
+// push the resolved step to the dac and trigger outputs
+static void step_output(void) {
+	u8 m;
 
- 		spi_write(DAC_SPI,cv0>>4);
- 		spi_write(DAC_SPI,cv0<<4);
-		spi_unselectChip(DAC_SPI,DAC_SPI_NPCS);
+	// write to DAC, both channels latched together
+	dac_set(cv0, cv1);
 
-		spi_selectChip(DAC_SPI,DAC_SPI_NPCS);
-		spi_write(DAC_SPI,0x38);	// update B
-		spi_write(DAC_SPI,cv1>>4);
-		spi_write(DAC_SPI,cv1<<4);
-		spi_unselectChip(SPI,DAC_SPI_NPCS);
+	// TRIGGER, muted channels are left alone
+	if(tr_fired) {
+		m = w->tr_mute[0] | (w->tr_mute[1] << 1) | (w->tr_mute[2] << 2) | (w->tr_mute[3] << 3);
 
+		if(w->wp[pattern].tr_mode == 0)
+			gate_trigger(triggered & m, step_period);
+		else
+			gate_hold(triggered & m, ~triggered & m);
+	}
+}
 
-		// TRIGGER
-		triggered = 0;
-		if((rnd() % 255) < w.wp[pattern].step_probs[pos]) {
-			
-			if(w.wp[pattern].step_choice & 1<<pos) {
-				count = 0;
-				for(i1=0;i1<4;i1++)
-					if(w.wp[pattern].steps[pos] >> i1 & 1) {
-						found[count] = i1;
-						count++;
-					}
+static void play_save(play_state *s) {
+	u8 i1;
 
-				if(count == 0)
-					triggered = 0;
-				else if(count == 1)
-					triggered = 1<<found[0];
-				else
-					triggered = 1<<found[rnd()%count];
-			}	
-			else {
-				triggered = w.wp[pattern].steps[pos];
-			}
-			
-			if(w.wp[pattern].tr_mode == 0) {
-				if(triggered & 0x1 && w.tr_mute[0]) gpio_set_gpio_pin(B00);
-				if(triggered & 0x2 && w.tr_mute[1]) gpio_set_gpio_pin(B01);
-				if(triggered & 0x4 && w.tr_mute[2]) gpio_set_gpio_pin(B02);
-				if(triggered & 0x8 && w.tr_mute[3]) gpio_set_gpio_pin(B03);
-			} else {
-				if(w.tr_mute[0]) {
-					if(triggered & 0x1) gpio_set_gpio_pin(B00);
-					else gpio_clr_gpio_pin(B00);
-				}
-				if(w.tr_mute[1]) {
-					if(triggered & 0x2) gpio_set_gpio_pin(B01);
-					else gpio_clr_gpio_pin(B01);
-				}
-				if(w.tr_mute[2]) {
-					if(triggered & 0x4) gpio_set_gpio_pin(B02);
-					else gpio_clr_gpio_pin(B02);
-				}
-				if(w.tr_mute[3]) {
-					if(triggered & 0x8) gpio_set_gpio_pin(B03);
-					else gpio_clr_gpio_pin(B03);
-				}
+	s->pattern = pattern;
+	s->next_pattern = next_pattern;
+	s->pattern_jump = pattern_jump;
+	s->series_pos = series_pos;
+	s->series_next = series_next;
+	s->series_jump = series_jump;
+	s->series_playing = series_playing;
+	s->series_step = series_step;
+	s->pos = pos;
+	s->cut_pos = cut_pos;
+	s->next_pos = next_pos;
+	s->drunk_step = drunk_step;
+	s->triggered = triggered;
+	s->tr_fired = tr_fired;
+	s->pattern_end = pattern_end;
+	s->cv_chosen[0] = cv_chosen[0];
+	s->cv_chosen[1] = cv_chosen[1];
+	s->cv0 = cv0;
+	s->cv1 = cv1;
+	for(i1=0;i1<16;i1++)
+		s->ping_dir[i1] = w->wp[i1].ping_dir;
+	// draws made ahead are made again after an invalidate, not new ones
+	memcpy(s->rnd_pattern, rnd_pattern, sizeof(rnd_pattern));
+	s->rnd_series = rnd_series;
+}
 
-			}
-		}
+static void play_load(play_state *s) {
+	u8 i1;
+
+	pattern = s->pattern;
+	next_pattern = s->next_pattern;
+	pattern_jump = s->pattern_jump;
+	series_pos = s->series_pos;
+	series_next = s->series_next;
+	series_jump = s->series_jump;
+	series_playing = s->series_playing;
+	series_step = s->series_step;
+	pos = s->pos;
+	cut_pos = s->cut_pos;
+	next_pos = s->next_pos;
+	drunk_step = s->drunk_step;
+	triggered = s->triggered;
+	tr_fired = s->tr_fired;
+	pattern_end = s->pattern_end;
+	cv_chosen[0] = s->cv_chosen[0];
+	cv_chosen[1] = s->cv_chosen[1];
+	cv0 = s->cv0;
+	cv1 = s->cv1;
+	for(i1=0;i1<16;i1++)
+		w->wp[i1].ping_dir = s->ping_dir[i1];
+	memcpy(rnd_pattern, s->rnd_pattern, sizeof(rnd_pattern));
+	rnd_series = s->rnd_series;
+}
+
+// anything that changes what the next step would resolve to calls this
+void step_invalidate(void) {
+	ahead_valid = 0;
+}
+
+// code outside the clock interrupt brackets such a change with these. an
+// edge landing inside resolves from the live state, as it would without
+// the lookahead, rather than loading one taken before the change
+void step_edit(void) {
+	step_editing++;
+	__asm__ __volatile__("" ::: "memory");
+}
+
+void step_edit_done(void) {
+	__asm__ __volatile__("" ::: "memory");
+	ahead_valid = 0;
+	step_editing--;
+}
+
+// restart the random streams from the loaded preset, so a preset plays
+// the same "random" choices every time it is loaded
+void play_seed(u8 preset) {
+	u8 i1;
+
+	for(i1=0;i1<16;i1++)
+		random_seed(&rnd_pattern[i1], (preset << 4) + i1);
+	random_seed(&rnd_series, 0x100 + preset);
+}
+
+// the fetched preset takes over. clock() only ever sees a whole set. the
+// caller sees to the step resolved ahead
+static void preset_swap(void) {
+	whale_set *old = w;
+
+	w = &sets[w == &sets[0]];
+	// a value being set from the param knob follows into the new set
+	if(param_dest >= (u16 *)old && param_dest < (u16 *)(old + 1))
+		param_dest = (u16 *)((u8 *)w + ((u8 *)param_dest - (u8 *)old));
+	preset_select = preset_next;
+	preset_next = PRESET_NONE;
+
+	play_seed(preset_select);
+	grid_dirty(GRID_ALL);
+}
+
+// whether a waiting preset takes over from the step about to be played,
+// the first of a pattern. not while the main loop is editing w, so no
+// edit lands in the set being put away; the switch then waits for the
+// pattern to end again
+static u8 preset_due(void) {
+	return preset_next != PRESET_NONE && !step_editing && pattern_end;
+}
+
+// resolve the next step ahead of its edge, leaving the playing state as is.
+// if a preset takes over on that edge, the step comes from its set, with
+// its streams, and the fetched set is left as it was
+static void step_prepare(void) {
+	static play_state now, fetched;
+	whale_set *playing = w;
+
+	// live record writes into the pattern on the edge itself
+	if(step_editing || (param_accept && live_in))
+		return;
+
+	play_save(&now);
+	ahead_switch = preset_due();
+	if(ahead_switch) {
+		w = &sets[w == &sets[0]];
+		play_save(&fetched);
+		play_seed(preset_next);
+	}
+	step_advance();
+	step_resolve();
+	play_save(&ahead);
+	if(ahead_switch) {
+		play_load(&fetched);
+		w = playing;
+	}
+	play_load(&now);
+	ahead_valid = 1;
+}
+
+void clock(u8 phase) {
+	static u32 last_edge;
+	u32 t;
+	u8 p, np, due;
+
+	if(phase) {
+		t = Get_sys_count();
+		p = pattern;
+		np = next_pattern;
+		gpio_set_gpio_pin(B10);
 
-		monomeFrameDirty++;
+		if(last_edge)
+			step_period = t - last_edge;
+		last_edge = t;
 
+		// a preset takes over on the edge itself. the step resolved ahead
+		// is only used if it came from the set that now plays
+		due = preset_due();
+		if(due != ahead_switch)
+			ahead_valid = 0;
+		if(due)
+			preset_swap();
+
+		if(step_lookahead && ahead_valid && !step_editing)
+			play_load(&ahead);
+		else {
+			step_advance();
+			step_resolve();
+		}
+		ahead_valid = 0;
+
+		step_output();
+
+		t = Get_sys_count() - t;
+		if(edge_count == 0 || t < edge_min) edge_min = t;
+		if(t > edge_max) edge_max = t;
+		edge_total += t;
+		edge_count++;
+
+		// a new pattern redraws everything, otherwise the playhead rows
+		if(pattern != p || next_pattern != np)
+			grid_dirty(GRID_ALL);
+		else if(edit_mode == mSeries)
+			grid_dirty(GRID_TOP | GRID_POS | GRID_EDIT);
+		else if(edit_prob == 0)
+			grid_dirty(GRID_TOP | GRID_POS | GRID_PLAY);
+		else
+			grid_dirty(GRID_TOP | GRID_POS);
+
+		latency_add(&lat_clock, Get_sys_count() - clock_edge_at);
 	}
 	else {
 		gpio_clr_gpio_pin(B10);
 
-		if(w.wp[pattern].tr_mode == 0) {
-			gpio_clr_gpio_pin(B00);
-			gpio_clr_gpio_pin(B01);
-			gpio_clr_gpio_pin(B02);
-			gpio_clr_gpio_pin(B03);
-		}
+		// a gate left high by gate mode, a mute or a pattern change
+		if(w->wp[pattern].tr_mode == 0)
+			gate_release();
+
+		if(step_lookahead)
+			step_prepare();
  	}
 
 	// print_dbg("\r\n pos: ");
 	// print_dbg_ulong(pos);
 }
 
+// edge to output time, in cpu cycles
+void clock_print_stats(void) {
+	print_dbg("\r\nedge to output (cycles) min ");
+	print_dbg_ulong(edge_min);
+	print_dbg(" avg ");
+	print_dbg_ulong(edge_count ? edge_total / edge_count : 0);
+	print_dbg(" max ");
+	print_dbg_ulong(edge_max);
+	print_dbg(" lookahead ");
+	print_dbg_ulong(step_lookahead);
+	print_dbg(" bpm x10 ");
+	print_dbg_ulong(tempo_bpm10());
+	print_dbg(" dac overruns ");
+	print_dbg_ulong(dac_overruns);
+	latency_print(&lat_clock);
+	extclock_print_stats();
+
+	edge_count = edge_total = edge_min = edge_max = 0;
+}
+
+// whether cy cycles fit before the next clock edge is due
+static u8 clock_gap(u32 cy) {
+	u32 since = Get_sys_count() - clock_edge_at;
+	u32 half = step_period / 2;
+
+	// not clocked, or the clock stopped: no edge to protect
+	if(half == 0 || since > step_period)
+		return 1;
+	return since + cy < half;
+}
+
 
 
 ////////////////////////////////////////////////////////////////////////////////
 // timers
 
-static softTimer_t clockTimer = { .next = NULL, .prev = NULL };
 static softTimer_t keyTimer = { .next = NULL, .prev = NULL };
 static softTimer_t adcTimer = { .next = NULL, .prev = NULL };
 static softTimer_t monomePollTimer = { .next = NULL, .prev = NULL };
 static softTimer_t monomeRefreshTimer  = { .next = NULL, .prev = NULL };
+static softTimer_t saveTimer = { .next = NULL, .prev = NULL };
 
+// refresh scheduling: keys refresh at once, clock steps are coalesced to
+// about one frame per step within these limits, and once nothing has
+// been drawn for a few frames the timer idles until something is dirty
+#define REFRESH_MIN_MS 10
+#define REFRESH_MAX_MS 30
+#define REFRESH_IDLE_MS 250
+#define REFRESH_IDLE_AFTER 8
 
+u8 refresh_ms = REFRESH_MAX_MS;
+u8 refresh_empty;
 
-static void clockTimer_callback(void* o) {  
-	// static event_t e;
-	// e.type = kEventTimer;
-	// e.data = 0;
-	// event_post(&e);
-	if(clock_external == 0) {
+
+
+// internal clock edge, from the tempo tc interrupt
+static void tempo_callback(void) {
+	if(clock_external == 0 || extclock_predict()) {
 		// print_dbg("\r\ntimer.");
 
 		clock_phase++;
 		if(clock_phase>1) clock_phase=0;
+		clock_edge_at = tempo_edge_at();
 		(*clock_pulse)(clock_phase);
 	}
 }
 
+// the first hold deadline is due
 static void keyTimer_callback(void* o) {  
-	static event_t e;
-	e.type = kEventKeyTimer;
-	e.data = 0;
-	event_post(&e);
+	queue_ring_post(&queue_timer, kEventKeyTimer, 0);
+}
+
+// arm the key timer for the first hold deadline, or stop it
+static void key_arm(void) {
+	u32 cy;
+
+	timer_remove(&keyTimer);
+	if(hold_next(Get_sys_count(), &cy))
+		timer_add(&keyTimer, cy / cpu_ms_2_cy(1, FMCK_HZ) + 1, &keyTimer_callback, NULL);
 }
 
 static void adcTimer_callback(void* o) {  
-	static event_t e;
-	e.type = kEventPollADC;
-	e.data = 0;
-	event_post(&e);
+	queue_ring_post(&queue_timer, kEventPollADC, 0);
+}
+
+// the journal has work: look for room for its next page
+static void saveTimer_callback(void* o) {
+	queue_ring_post(&queue_timer, kEventSaveFlash, savePage);
 }
 
 
@@ -553,20 +1004,60 @@ static void monome_poll_timer_callback(void* obj) {
 	ftdi_read();
 }
 
+
 // monome refresh callback
 static void monome_refresh_timer_callback(void* obj) {
-	if(monomeFrameDirty > 0) {
-		static event_t e;
-		e.type = kEventMonomeRefresh;
-		event_post(&e);
+	if(grid_rows || frame_pending) {
+		queue_ring_post(&queue_timer, kEventMonomeRefresh, 0);
+		// back to the frame period after waking from idle or a retry
+		if(monomeRefreshTimer.ticks != refresh_ms)
+			timer_set(&monomeRefreshTimer, refresh_ms);
+		refresh_empty = 0;
+	}
+	else if(refresh_empty < REFRESH_IDLE_AFTER && ++refresh_empty == REFRESH_IDLE_AFTER)
+		timer_set(&monomeRefreshTimer, REFRESH_IDLE_MS);
+}
+
+// something became dirty while idle: refresh on the next tick
+static void refresh_wake(void) {
+	if(refresh_empty >= REFRESH_IDLE_AFTER)
+		timer_set(&monomeRefreshTimer, 1);
+}
+
+// frame period from the clock and how long the last frame took to send
+static void refresh_adapt(void) {
+	u32 ms;
+
+	ms = step_period / (FMCK_HZ / 1000);
+	if(ms < REFRESH_MIN_MS)
+		ms = REFRESH_MIN_MS;
+	else if(ms > REFRESH_MAX_MS)
+		ms = REFRESH_MAX_MS;
+
+	// leave the usb idle at least half the time
+	if(ms < frame_send_max / (FMCK_HZ / 2000) + 1)
+		ms = frame_send_max / (FMCK_HZ / 2000) + 1;
+
+	if(ms != refresh_ms) {
+		refresh_ms = ms;
+		if(refresh_empty < REFRESH_IDLE_AFTER)
+			timer_set(&monomeRefreshTimer, refresh_ms);
 	}
 }
 
+void refresh_print_stats(void) {
+	print_dbg("\r\nrefresh ms ");
+	print_dbg_ulong(refresh_empty >= REFRESH_IDLE_AFTER ? REFRESH_IDLE_MS : refresh_ms);
+	latency_print(&lat_key);
+	latency_print(&lat_key_led);
+}
+
 // monome: start polling
 void timers_set_monome(void) {
 	// print_dbg("\r\n setting monome timers");
+	refresh_empty = 0;
 	timer_add(&monomePollTimer, 20, &monome_poll_timer_callback, NULL );
-	timer_add(&monomeRefreshTimer, 30, &monome_refresh_timer_callback, NULL );
+	timer_add(&monomeRefreshTimer, refresh_ms, &monome_refresh_timer_callback, NULL );
 }
 
 // monome stop polling
@@ -592,7 +1083,7 @@ static void handler_MonomeConnect(s32 data) {
 	u8 i1;
 	// print_dbg("\r\n// monome connect /////////////////"); 
 	keycount_pos = 0;
-	key_count = 0;
+	hold_clear_keys();
 	SIZE = monome_size_x();
 	LENGTH = SIZE - 1;
 	// print_dbg("\r monome size: ");
@@ -601,76 +1092,122 @@ static void handler_MonomeConnect(s32 data) {
 	// print_dbg("\r monome vari: ");
 	// print_dbg_ulong(VARI);
 
-	if(VARI) re = &refresh;
-	else re = &refresh_mono;
+	pal = VARI ? &palette_vari : &palette_mono;
+	lay = SIZE == 16 ? &layout16 : &layout8;
 
+	step_edit();
 	for(i1=0;i1<16;i1++)
-		if(w.wp[i1].loop_end > LENGTH)
-			w.wp[i1].loop_end = LENGTH;
-	
+		if(w->wp[i1].loop_end > LENGTH)
+			w->wp[i1].loop_end = LENGTH;
+	step_edit_done();
 
-	// monome_set_quadrant_flag(0);
-	// monome_set_quadrant_flag(1);
+	frame_reset(SIZE, VARI);
+	grid_dirty(GRID_ALL);
 	timers_set_monome();
 }
 
-static void handler_MonomePoll(s32 data) { monome_read_serial(); }
+static void handler_MonomePoll(s32 data) {
+	key_read_at = Get_sys_count();
+	monome_read_serial();
+}
 static void handler_MonomeRefresh(s32 data) {
-	if(monomeFrameDirty) {
-		if(preset_mode == 0) (*re)(); //refresh_mono();
+	if(grid_rows || frame_pending) {
+		if(preset_mode == 0) refresh();
 		else refresh_preset();
 
-		(*monome_refresh)();
+		frame_send();
+		refresh_adapt();
+
+		if(key_led_pending && !frame_pending) {
+			latency_add(&lat_key_led, Get_sys_count() - key_led_at);
+			key_led_pending = 0;
+		}
+
+		// usb was still busy with the last frame: try again next tick
+		if(frame_pending)
+			timer_set(&monomeRefreshTimer, 1);
 	}
 }
 
 
+static void print_stats(void) {
+	clock_print_stats();
+	frame_print_stats();
+	refresh_print_stats();
+	queue_print_stats();
+	store_print_stats();
+	journal_print_stats();
+	flash_print_stats();
+}
+
 static void handler_Front(s32 data) {
 	print_dbg("\r\n FRONT HOLD");
 
+	// pressed with the grid's alt key held, it prints the timing stats and
+	// does nothing else. they block the main loop while the uart sends
+	// them, so only when asked
+	if(data == 0 && key_alt) {
+		print_stats();
+		return;
+	}
+
 	if(data == 0) {
-		front_timer = 15;
+		hold_start(HOLD_FRONT, Get_sys_count() + cpu_ms_2_cy(FRONT_HOLD_MS, FMCK_HZ));
 		if(preset_mode) preset_mode = 0;
 		else preset_mode = 1;
 	}
-	else {
-		front_timer = 0;
-	}
+	else
+		hold_cancel(HOLD_FRONT);
+	key_arm();
 
-	monomeFrameDirty++;
+	grid_dirty(GRID_ALL);
 }
 
 static void handler_PollADC(s32 data) {
-	u16 i;
+	u16 i, n;
 	adc_convert(&adc);
 
 	// CLOCK POT INPUT
 	i = adc[0];
 	i = i>>2;
-	if(i != clock_temp) {
-		// 1000ms - 24ms
-		clock_time = 25000 / (i + 25);
-		// print_dbg("\r\nnew clock (ms): ");
-		// print_dbg_ulong(clock_time);
-
-		timer_set(&clockTimer, clock_time);
+	if(clock_external) {
+		// clock ratio when patched. the zone changes only away from its
+		// edges, but after patching the one the pot is in applies at once,
+		// so a ratio from before is never left standing
+		n = i % EXT_ZONE;
+		if(ext_zone == EXT_NONE || (i != clock_temp && n > 8 && n < EXT_ZONE - 8)) {
+			ext_zone = i / EXT_ZONE;
+			if(ext_ratio[ext_zone][0] != extclock_mul || ext_ratio[ext_zone][1] != extclock_div)
+				extclock_ratio(ext_ratio[ext_zone][0], ext_ratio[ext_zone][1]);
+		}
+	}
+	else if(i != clock_temp) {
+		// 1000ms - 24ms per phase, cycles << 16
+		tempo_set(((u64)FMCK_HZ * 25 << 16) / (i + 25));
+		// print_dbg("\r\nnew bpm x10: ");
+		// print_dbg_ulong(tempo_bpm10());
 	}
 	clock_temp = i;
 
 	// PARAM POT INPUT
 	if(param_accept && edit_prob) {
+		step_edit();
 		*param_dest8 = adc[1] >> 4; // scale to 0-255;
+		step_edit_done();
+		grid_dirty(GRID_EDIT);
 		// print_dbg("\r\nnew prob: ");
 		// print_dbg_ulong(*param_dest8);
 		// print_dbg("\t" );
 		// print_dbg_ulong(adc[1]);
 	}
 	else if(param_accept) {
+		step_edit();
 		if(quantize_in)
 			*param_dest = (adc[1] / 34) * 34;
 		else
 			*param_dest = adc[1];
-		monomeFrameDirty++;
+		step_edit_done();
+		grid_dirty(GRID_EDIT);
 	}
 	else if(key_meta) {
 		i = adc[1]>>6;
@@ -678,94 +1215,158 @@ static void handler_PollADC(s32 data) {
 			i = 58;
 		if(i != scroll_pos) {
 			scroll_pos = i;
-			monomeFrameDirty++;
+			grid_dirty(GRID_PATTERN | GRID_EDIT);
 			// print_dbg("\r scroll pos: ");
 			// print_dbg_ulong(scroll_pos);
 		}
 	}
 }
 
+// run the save timer for as long as the journal has work
+static void save_tick(void) {
+	if(journal_busy() && !save_ticking) {
+		timer_add(&saveTimer, 1, &saveTimer_callback, NULL);
+		save_ticking = 1;
+	}
+	else if(!journal_busy() && save_ticking) {
+		timer_remove(&saveTimer);
+		save_ticking = 0;
+	}
+}
+
 static void handler_SaveFlash(s32 data) {
-	flash_write();
+	u32 t;
+
+	switch(data) {
+	case saveStart:
+		flash_write();
+		save_active = 1;
+		break;
+
+	case savePage:
+		// a save waits for a gap only so long; tidying waits for ever
+		if(journal_busy() && (clock_gap(save_page_cy) || (journal_saving() && ++save_waited >= SAVE_WAIT_MS))) {
+			t = journal_step();
+			if(t > save_page_cy)
+				save_page_cy = t;
+			save_waited = 0;
+		}
+		break;
+
+	case saveDone:
+		print_dbg("\r\n saved preset ");
+		print_dbg_ulong(save->preset_select);
+		print_dbg(" pages written ");
+		print_dbg_ulong(store_pages);
+		return;
+	}
+
+	if(save_active && !journal_saving()) {
+		save_active = 0;
+		queue_post(kEventSaveFlash, saveDone);
+	}
+	save_tick();
+}
+
+// a preset from ii, fetched here rather than in the twi interrupt
+static void handler_II(s32 data) {
+	flash_read(data, switchNow);
 }
 
 static void handler_KeyTimer(s32 data) {
-	static u16 i1,x,n1;
+	u8 k, x, n1;
 
-	if(front_timer) {
-		if(front_timer == 1) {
-			static event_t e;
-			e.type = kEventSaveFlash;
-			event_post(&e);
+	while((k = hold_due(Get_sys_count())) != HOLD_NONE) {
+		// front held: save and leave the preset screen
+		if(k == HOLD_FRONT) {
+			queue_post(kEventSaveFlash, saveStart);
 
 			preset_mode = 0;
-			front_timer--;
+			grid_dirty(GRID_ALL);
 		}
-		else front_timer--;
-	}
-
-	for(i1=0;i1<key_count;i1++) {
-		if(key_times[held_keys[i1]])
-		if(--key_times[held_keys[i1]]==0) {
-			if(edit_mode != mSeries && preset_mode == 0) {
-				// preset copy
-				if(held_keys[i1] / 16 == 2) {
-					x = held_keys[i1] % 16;
-					for(n1=0;n1<16;n1++) {
-						w.wp[x].steps[n1] = w.wp[pattern].steps[n1];
-						w.wp[x].step_probs[n1] = w.wp[pattern].step_probs[n1];
-						w.wp[x].cv_values[n1] = w.wp[pattern].cv_values[n1];
-						w.wp[x].cv_steps[0][n1] = w.wp[pattern].cv_steps[0][n1];
-						w.wp[x].cv_curves[0][n1] = w.wp[pattern].cv_curves[0][n1];
-						w.wp[x].cv_probs[0][n1] = w.wp[pattern].cv_probs[0][n1];
-						w.wp[x].cv_steps[1][n1] = w.wp[pattern].cv_steps[1][n1];
-						w.wp[x].cv_curves[1][n1] = w.wp[pattern].cv_curves[1][n1];
-						w.wp[x].cv_probs[1][n1] = w.wp[pattern].cv_probs[1][n1];
-					}
+		else if(edit_mode != mSeries && preset_mode == 0) {
+			// preset copy
+			if(k / 16 == 2) {
+				x = k % 16;
+				step_edit();
+				for(n1=0;n1<16;n1++) {
+					w->wp[x].steps[n1] = w->wp[pattern].steps[n1];
+					w->wp[x].step_probs[n1] = w->wp[pattern].step_probs[n1];
+					w->wp[x].cv_values[n1] = w->wp[pattern].cv_values[n1];
+					w->wp[x].cv_steps[0][n1] = w->wp[pattern].cv_steps[0][n1];
+					w->wp[x].cv_curves[0][n1] = w->wp[pattern].cv_curves[0][n1];
+					w->wp[x].cv_probs[0][n1] = w->wp[pattern].cv_probs[0][n1];
+					w->wp[x].cv_steps[1][n1] = w->wp[pattern].cv_steps[1][n1];
+					w->wp[x].cv_curves[1][n1] = w->wp[pattern].cv_curves[1][n1];
+					w->wp[x].cv_probs[1][n1] = w->wp[pattern].cv_probs[1][n1];
+				}
 
-					w.wp[x].cv_mode[0] = w.wp[pattern].cv_mode[0];
-					w.wp[x].cv_mode[1] = w.wp[pattern].cv_mode[1];
+				w->wp[x].cv_mode[0] = w->wp[pattern].cv_mode[0];
+				w->wp[x].cv_mode[1] = w->wp[pattern].cv_mode[1];
 
-					w.wp[x].loop_start = w.wp[pattern].loop_start;
-					w.wp[x].loop_end = w.wp[pattern].loop_end;
-					w.wp[x].loop_len = w.wp[pattern].loop_len;
-					w.wp[x].loop_dir = w.wp[pattern].loop_dir;
+				w->wp[x].loop_start = w->wp[pattern].loop_start;
+				w->wp[x].loop_end = w->wp[pattern].loop_end;
+				w->wp[x].loop_len = w->wp[pattern].loop_len;
+				w->wp[x].loop_dir = w->wp[pattern].loop_dir;
 
-					w.wp[x].tr_mode = w.wp[pattern].tr_mode;
-					w.wp[x].step_mode = w.wp[pattern].step_mode;
-					w.wp[x].ping_dir = w.wp[pattern].ping_dir;
+				w->wp[x].tr_mode = w->wp[pattern].tr_mode;
+				w->wp[x].step_mode = w->wp[pattern].step_mode;
+				w->wp[x].ping_dir = w->wp[pattern].ping_dir;
 
-					pattern = x;
-					next_pattern = x;
-					monomeFrameDirty++;
+				pattern = x;
+				next_pattern = x;
+				step_edit_done();
+				grid_dirty(GRID_ALL);
 
-					// print_dbg("\r\n saved pattern: ");
-					// print_dbg_ulong(x);
-				}
+				// print_dbg("\r\n saved pattern: ");
+				// print_dbg_ulong(x);
 			}
-			else if(preset_mode == 1) {
-				if(held_keys[i1] % 16 == 0) {
-					preset_select = held_keys[i1] / 16;
-					// flash_write();
-					static event_t e;
-					e.type = kEventSaveFlash;
-					event_post(&e);
-					preset_mode = 0;
-				}
+		}
+		else if(preset_mode == 1) {
+			if(k % 16 == 0) {
+				preset_select = k / 16;
+				// flash_write();
+				queue_post(kEventSaveFlash, saveStart);
+				preset_mode = 0;
+				grid_dirty(GRID_ALL);
 			}
-
-			// print_dbg("\rlong press: "); 
-			// print_dbg_ulong(held_keys[i1]);
 		}
+
+		// print_dbg("\rlong press: "); 
+		// print_dbg_ulong(k);
 	}
+
+	key_arm();
 }
 
 static void handler_ClockNormal(s32 data) {
 	clock_external = !gpio_get_pin_value(B09); 
+	// re-read the pot as tempo or clock ratio
+	clock_temp = 10000;
+	ext_zone = EXT_NONE;
+}
+
+// clock() otherwise runs from the tempo interrupt, which mustn't enter it
+// again while it runs from here
+static void clock_masked(u8 phase) {
+	irqflags_t flags = cpu_irq_save();
+	clock(phase);
+	cpu_irq_restore(flags);
 }
 
 static void handler_ClockExt(s32 data) {
-	clock(data); 
+	// the pin interrupt isn't ours, so this is as early as the edge is seen
+	clock_edge_at = Get_sys_count();
+
+	if(extclock_mul == 1 && extclock_div == 1) {
+		if(data)
+			extclock_edge(clock_edge_at);
+		clock_masked(data);
+	}
+	else if(data && extclock_edge(clock_edge_at)) {
+		clock_phase = 1;
+		clock_masked(clock_phase);
+	}
 }
 
 
@@ -775,1035 +1376,911 @@ static void handler_ClockExt(s32 data) {
 ////////////////////////////////////////////////////////////////////////////////
 // application grid code
 
-static void handler_MonomeGridKey(s32 data) { 
-	u8 x, y, z, index, i1, found, count;
-	s16 delta;
-	monome_grid_key_parse_event_data(data, &x, &y, &z);
-	// print_dbg("\r\n monome event; x: "); 
-	// print_dbg_hex(x); 
-	// print_dbg("; y: 0x"); 
-	// print_dbg_hex(y); 
-	// print_dbg("; z: 0x"); 
-	// print_dbg_hex(z);
+// grid keys are dispatched on the view the grid shows and the row pressed,
+// and where alt or meta change what a key does, on the held modifier.
+// modifier order matches the old if-chains: alt wins over meta.
+typedef void(*key_fn)(u8 x, u8 y, u8 z);
+typedef void(*key_mod_fn)(u8 x, u8 y);
 
-	//// TRACK LONG PRESSES
-	index = y*16 + x;
-	if(z) {
-		held_keys[key_count] = index;
-		key_count++;
-		key_times[index] = 10;		//// THRESHOLD key hold time
-	} else {
-		found = 0; // "found"
-		for(i1 = 0; i1<key_count; i1++) {
-			if(held_keys[i1] == index) 
-				found++;
-			if(found) 
-				held_keys[i1] = held_keys[i1+1];
-		}
-		key_count--;
+typedef enum {
+	kvTrig, kvTrigProb, kvCurves, kvMap, kvScale, kvMapProb, kvSeries, kvPreset,
+	kvViews
+} key_views;
 
-		// FAST PRESS
-		if(key_times[index] > 0) {
-			if(edit_mode != mSeries && preset_mode == 0) {
-				if(index/16 == 2) {
-					i1 = index % 16;
-					if(key_alt)
-						next_pattern = i1;
-					else {
-						pattern = i1;
-						next_pattern = i1;
-					}
-				}
-			}
-			// PRESET MODE FAST PRESS DETECT
-			else if(preset_mode == 1) {
-				if(x == 0 && y != preset_select) {
-					preset_select = y;
-					for(i1=0;i1<8;i1++)
-						glyph[i1] = flashy.glyph[preset_select][i1];
-				}
- 				else if(x==0 && y == preset_select) {
-					flash_read();
+#define KEY_MODS 3
 
-					preset_mode = 0;
-				}
-			}
-			// print_dbg("\r\nfast press: ");
-			// print_dbg_ulong(index);
-			// print_dbg(": ");
-			// print_dbg_ulong(key_times[index]);
+static inline u8 key_mod(void) {
+	return key_alt ? 1 : key_meta ? 2 : 0;
+}
+
+static void key_none(u8 x, u8 y, u8 z) { }
+
+// glyph magic
+static void key_glyph(u8 x, u8 y, u8 z) {
+	if(z && x>7)
+		glyph[y] ^= 1<<(x-8);
+}
+
+// top row: trigger keys
+static void key_tr_select(u8 x, u8 y) { edit_mode = mTrig; }
+static void key_tr_mode(u8 x, u8 y) {
+	w->wp[pattern].tr_mode ^= 1;
+	if(w->wp[pattern].tr_mode == 0)
+		gate_release();
+}
+static void key_tr_mute(u8 x, u8 y) { w->tr_mute[x] ^= 1; }
+
+static const key_mod_fn key_tr[KEY_MODS] = {
+	key_tr_select, key_tr_mode, key_tr_mute
+};
+
+// top row: cv keys, x is the channel
+static void key_cv_select(u8 x, u8 y) { edit_mode = mMap; }
+static void key_cv_mode(u8 x, u8 y) { w->wp[pattern].cv_mode[x] ^= 1; }
+static void key_cv_mute(u8 x, u8 y) { w->cv_mute[x] ^= 1; }
+
+static const key_mod_fn key_cv[KEY_MODS] = {
+	key_cv_select, key_cv_mode, key_cv_mute
+};
+
+static void key_top(u8 x, u8 y, u8 z) {
+	if(x == LENGTH) {
+		key_alt = z;
+		if(z == 0) {
+			param_accept = 0;
+			live_in = 0;
 		}
 	}
-
-	// PRESET SCREEN
-	if(preset_mode) {
-		// glyph magic
-		if(z && x>7) {
-			glyph[y] ^= 1<<(x-8);
-			monomeFrameDirty++;	
+	else if(x < 4) {
+		if(z) {
+			(*key_tr[key_mod()])(x, y);
+			edit_prob = 0;
+			param_accept = 0;
 		}
 	}
-	// NOT PRESET
-	else {
+	else if(x >= lay->cv_x[0] && x < lay->cv_x[1] + lay->cv_w) {
+		if(z) {
+			param_accept = 0;
+			edit_cv_ch = (x - lay->cv_x[0]) / lay->cv_w;
+			edit_prob = 0;
+			if(lay->cv_map)
+				edit_mode = mMap;
+			(*key_cv[key_mod()])(edit_cv_ch, y);
+		}
+	}
+	else if(x == LENGTH-1 && z && key_alt) {
+		edit_mode = mSeries;
+	}
+	else if(x == LENGTH-1)
+		key_meta = z;
+}
 
-		// OPTIMIZE: order this if-branch by common priority/use
-		//// SORT
-
-		// cut position
-		if(y == 1) {
-			keycount_pos += z * 2 - 1;
-			if(keycount_pos < 0) keycount_pos = 0;
-			// print_dbg("\r\nkeycount: "); 
-			// print_dbg_ulong(keycount_pos);
-
-			if(keycount_pos == 1 && z) {
-				if(key_alt == 0) {
-					if(key_meta != 1) {
-						next_pos = x;
-						cut_pos++;
-						monomeFrameDirty++;
-					}
-					keyfirst_pos = x;
-				}
-				else if(key_alt == 1) {
-                    if ((LENGTH > 8  && (LENGTH - x) <= mPingRep) || ((LENGTH - x) <= mPing)) {
-                        // Step modes, mPingRep not available on 8x8 grid
-                        w.wp[pattern].step_mode = LENGTH-x;
-                        w.wp[pattern].ping_dir = mPingFwd;
-                    }
-                    // FIXME
-                    else if(x == 0) {
-                        if(pos == w.wp[pattern].loop_start)
-                            next_pos = w.wp[pattern].loop_end;
-                        else if(pos == 0)
-                            next_pos = LENGTH;
-                        else next_pos--;
-                        cut_pos = 1;
-                        monomeFrameDirty++;
-                    }
-                    // FIXME
-                    else if(x == 1) {
-                        if(pos == w.wp[pattern].loop_end) next_pos = w.wp[pattern].loop_start;
-                        else if(pos == LENGTH) next_pos = 0;
-                        else next_pos++;
-                        cut_pos = 1;
-                        monomeFrameDirty++;
-                    }
-                    else if(x == 2 ) {
-                        next_pos = (rnd() % (w.wp[pattern].loop_len + 1)) + w.wp[pattern].loop_start;
-                        cut_pos = 1;
-                        monomeFrameDirty++;					
-                    }
-				}
+// cut position
+static void key_pos(u8 x, u8 y, u8 z) {
+	keycount_pos += z * 2 - 1;
+	if(keycount_pos < 0) keycount_pos = 0;
+	// print_dbg("\r\nkeycount: "); 
+	// print_dbg_ulong(keycount_pos);
+
+	if(keycount_pos == 1 && z) {
+		if(key_alt == 0) {
+			if(key_meta != 1) {
+				next_pos = x;
+				cut_pos++;
 			}
-			else if(keycount_pos == 2 && z) {
-				w.wp[pattern].loop_start = keyfirst_pos;
-				w.wp[pattern].loop_end = x;
-	 			monomeFrameDirty++;
-	 			if(w.wp[pattern].loop_start > w.wp[pattern].loop_end) w.wp[pattern].loop_dir = 2;
-	 			else if(w.wp[pattern].loop_start == 0 && w.wp[pattern].loop_end == LENGTH) w.wp[pattern].loop_dir = 0;
-	 			else w.wp[pattern].loop_dir = 1;
+			keyfirst_pos = x;
+		}
+		else if(key_alt == 1) {
+            if ((LENGTH > 8  && (LENGTH - x) <= mPingRep) || ((LENGTH - x) <= mPing)) {
+                // Step modes, mPingRep not available on 8x8 grid
+                w->wp[pattern].step_mode = LENGTH-x;
+                w->wp[pattern].ping_dir = mPingFwd;
+            }
+            // FIXME
+            else if(x == 0) {
+                if(pos == w->wp[pattern].loop_start)
+                    next_pos = w->wp[pattern].loop_end;
+                else if(pos == 0)
+                    next_pos = LENGTH;
+                else next_pos--;
+                cut_pos = 1;
+            }
+            // FIXME
+            else if(x == 1) {
+                if(pos == w->wp[pattern].loop_end) next_pos = w->wp[pattern].loop_start;
+                else if(pos == LENGTH) next_pos = 0;
+                else next_pos++;
+                cut_pos = 1;
+            }
+            else if(x == 2 ) {
+                next_pos = random_range(&rnd_edit, w->wp[pattern].loop_len + 1) + w->wp[pattern].loop_start;
+                cut_pos = 1;
+            }
+		}
+	}
+	else if(keycount_pos == 2 && z) {
+		w->wp[pattern].loop_start = keyfirst_pos;
+		w->wp[pattern].loop_end = x;
+			if(w->wp[pattern].loop_start > w->wp[pattern].loop_end) w->wp[pattern].loop_dir = 2;
+			else if(w->wp[pattern].loop_start == 0 && w->wp[pattern].loop_end == LENGTH) w->wp[pattern].loop_dir = 0;
+			else w->wp[pattern].loop_dir = 1;
 
-	 			w.wp[pattern].loop_len = w.wp[pattern].loop_end - w.wp[pattern].loop_start;
+			w->wp[pattern].loop_len = w->wp[pattern].loop_end - w->wp[pattern].loop_start;
 
-	 			if(w.wp[pattern].loop_dir == 2)
-	 				w.wp[pattern].loop_len = (LENGTH - w.wp[pattern].loop_start) + w.wp[pattern].loop_end + 1;
+			if(w->wp[pattern].loop_dir == 2)
+				w->wp[pattern].loop_len = (LENGTH - w->wp[pattern].loop_start) + w->wp[pattern].loop_end + 1;
 
-				// print_dbg("\r\nloop_len: "); 
-				// print_dbg_ulong(w.wp[pattern].loop_len);
-			}
+		// print_dbg("\r\nloop_len: "); 
+		// print_dbg_ulong(w->wp[pattern].loop_len);
+	}
+}
+
+// probability row: full or off, alt opens the probability view
+static void prob_toggle(u8 *probs, u8 x, u8 z) {
+	if(z) {
+		if(key_alt)
+			edit_prob = 1;
+		else {
+			if(probs[x] == 255) probs[x] = 0;
+			else probs[x] = 255;
 		}
+	}
+}
 
-		// top row
-		else if(y == 0) {
-			if(x == LENGTH) {
-				key_alt = z;
-				if(z == 0) {
-					param_accept = 0;
-					live_in = 0;
-				}
-				monomeFrameDirty++;
-			}
-			else if(x < 4 && z) {
-				if(key_alt)
-					w.wp[pattern].tr_mode ^= 1;
-				else if(key_meta)
-					w.tr_mute[x] ^= 1;
-				else 
-					edit_mode = mTrig;
-				edit_prob = 0;
-				param_accept = 0;
-				monomeFrameDirty++;
-			}
-			else if(SIZE==16 && x > 3 && x < 12 && z) {
-				param_accept = 0;
-				edit_cv_ch = (x-4)/4;
-				edit_prob = 0;
-
-				if(key_alt)
-					w.wp[pattern].cv_mode[edit_cv_ch] ^= 1;
-				else if(key_meta)
-					w.cv_mute[edit_cv_ch] ^= 1;
-				else
-					edit_mode = mMap;
+// probability view: a level per row, the rows below the grid's reach as 0
+static void prob_level(u8 *probs, u8 x, u8 y, u8 z) {
+	if(z) {
+		if(y == 4) probs[x] = 192;
+		else if(y == 5) probs[x] = 128;
+		else if(y == 6) probs[x] = 64;
+		else probs[x] = 0;
+	}
+}
 
-				monomeFrameDirty++;
-			}
-			else if(SIZE==8 && (x == 4 || x == 5) && z) {
-				param_accept = 0;
-				edit_cv_ch = x-4;
-				edit_mode = mMap;
-				edit_prob = 0;
+static void key_step_prob(u8 x, u8 y, u8 z) { prob_toggle(w->wp[pattern].step_probs, x, z); }
+static void key_step_level(u8 x, u8 y, u8 z) { prob_level(w->wp[pattern].step_probs, x, y, z); }
+static void key_cv_prob(u8 x, u8 y, u8 z) { prob_toggle(w->wp[pattern].cv_probs[edit_cv_ch], x, z); }
+static void key_cv_level(u8 x, u8 y, u8 z) { prob_level(w->wp[pattern].cv_probs[edit_cv_ch], x, y, z); }
 
-				if(key_alt)
-					w.wp[pattern].cv_mode[edit_cv_ch] ^= 1;
-				else if(key_meta)
-					w.cv_mute[edit_cv_ch] ^= 1;
+// toggle steps
+static void key_step_toggle(u8 x, u8 y) { w->wp[pattern].steps[x] ^= (1<<(y-4)); }
+static void key_step_now(u8 x, u8 y) { w->wp[pattern].steps[pos] |=  1 << (y-4); }
+static void key_step_choice(u8 x, u8 y) { w->wp[pattern].step_choice ^= (1<<x); }
 
-				monomeFrameDirty++;
-			}
-			else if(x == LENGTH-1 && z && key_alt) {
-				edit_mode = mSeries;
-				monomeFrameDirty++;
-			}
-			else if(x == LENGTH-1)
-				key_meta = z;
-		}
+static const key_mod_fn key_steps[KEY_MODS] = {
+	key_step_toggle, key_step_now, key_step_choice
+};
 
+static void key_step(u8 x, u8 y, u8 z) {
+	if(z)
+		(*key_steps[key_mod()])(x, y);
+}
 
-		// toggle steps and prob control
-		else if(edit_mode == mTrig) {
-			if(z && y>3 && edit_prob == 0) {
-				if(key_alt)
-					w.wp[pattern].steps[pos] |=  1 << (y-4);
-				else if(key_meta) {
-					w.wp[pattern].step_choice ^= (1<<x);
-				}
-				else
-					w.wp[pattern].steps[x] ^= (1<<(y-4));
-				monomeFrameDirty++;
-			}
-			// step probs
-			else if(z && y==3) {
-				if(key_alt)
-					edit_prob = 1;
-				else {
-					if(w.wp[pattern].step_probs[x] == 255) w.wp[pattern].step_probs[x] = 0;
-					else w.wp[pattern].step_probs[x] = 255;
-				}	
-				monomeFrameDirty++;
-			}
-			else if(edit_prob == 1) {
-				if(z) {
-					if(y == 4) w.wp[pattern].step_probs[x] = 192;
-					else if(y == 5) w.wp[pattern].step_probs[x] = 128;
-					else if(y == 6) w.wp[pattern].step_probs[x] = 64;
-					else w.wp[pattern].step_probs[x] = 0;
-				}
-			}
-		}	
-		
-		// edit map and probs
-		else if(edit_mode == mMap) {
-			// step probs
-			if(z && y==3) {
-				if(key_alt)
-					edit_prob = 1;
-				else  {
-					if(w.wp[pattern].cv_probs[edit_cv_ch][x] == 255) w.wp[pattern].cv_probs[edit_cv_ch][x] = 0;
-					else w.wp[pattern].cv_probs[edit_cv_ch][x] = 255;
-				}
-					
-				monomeFrameDirty++;
-			}
-			// edit data
-			else if(edit_prob == 0) {
-				// CURVES
-				if(w.wp[pattern].cv_mode[edit_cv_ch] == 0) {
-					if(y == 4 && z) {
-						if(center) 
-							delta = 3;
-						else if(key_alt)
-							delta = 409;
-						else						
-							delta = 34;
-
-						if(key_meta == 0) {
-							// saturate
-							if(w.wp[pattern].cv_curves[edit_cv_ch][x] + delta < 4092)
-								w.wp[pattern].cv_curves[edit_cv_ch][x] += delta;
-							else
-								w.wp[pattern].cv_curves[edit_cv_ch][x] = 4092;
-						}
-						else {
-							for(i1=0;i1<16;i1++) {
-								// saturate
-								if(w.wp[pattern].cv_curves[edit_cv_ch][i1] + delta < 4092)
-									w.wp[pattern].cv_curves[edit_cv_ch][i1] += delta;
-								else
-									w.wp[pattern].cv_curves[edit_cv_ch][i1] = 4092;
-							}
-						}
-					}
-					else if(y == 6 && z) {
-						if(center)
-							delta = 3;
-						else if(key_alt)
-							delta = 409;
-						else
-							delta = 34;
-
-						if(key_meta == 0) {
-							// saturate
-							if(w.wp[pattern].cv_curves[edit_cv_ch][x] > delta)
-								w.wp[pattern].cv_curves[edit_cv_ch][x] -= delta;
-							else
-								w.wp[pattern].cv_curves[edit_cv_ch][x] = 0;
-						}
-						else {
-							for(i1=0;i1<16;i1++) {
-								// saturate
-								if(w.wp[pattern].cv_curves[edit_cv_ch][i1] > delta)
-									w.wp[pattern].cv_curves[edit_cv_ch][i1] -= delta;
-								else
-									w.wp[pattern].cv_curves[edit_cv_ch][i1] = 0;
-							}
-						}
+// CURVES
+static s16 curve_delta(void) {
+	if(center)
+		return 3;
+	else if(key_alt)
+		return 409;
+	else
+		return 34;
+}
 
-					}
-					else if(y == 5) {
-						if(z == 1) {
-	 						center = 1;
-	 						if(quantize_in)
-	 							quantize_in = 0;
-	 						else if(key_alt)
-								w.wp[pattern].cv_curves[edit_cv_ch][x] = clip;
-							else
-								clip = w.wp[pattern].cv_curves[edit_cv_ch][x];
-						}
-						else
-							center = 0;
-					}
-					else if(y == 7) {
-						if(key_alt && z) {
-							param_dest = &w.wp[pattern].cv_curves[edit_cv_ch][pos];
-							w.wp[pattern].cv_curves[edit_cv_ch][pos] = (adc[1] / 34) * 34;
-							quantize_in = 1;
-							param_accept = 1;
-							live_in = 1;
-						}
-						else if(center && z) {
-							if(key_meta == 0) 
-								w.wp[pattern].cv_curves[edit_cv_ch][x] = rand() % ((adc[1] / 34) * 34 + 1);
-							else {
-								for(i1=0;i1<16;i1++) {
-									w.wp[pattern].cv_curves[edit_cv_ch][i1] = rand() % ((adc[1] / 34) * 34 + 1);
-								}
-							}
-						}
-						else {
-							param_accept = z;
-							param_dest = &w.wp[pattern].cv_curves[edit_cv_ch][x];
-							if(z) {
-								w.wp[pattern].cv_curves[edit_cv_ch][x] = (adc[1] / 34) * 34;
-								quantize_in = 1;
-							}
-							else
-								quantize_in = 0;
-						}
-						monomeFrameDirty++;
-					}
-				}
-				// MAP
-				else {
-					if(scale_select && z) {
-						// index -= 64;
-						index = (y-4) * 8 + x;
-						if(index < 24 && y<8) {
-							for(i1=0;i1<16;i1++)
-								w.wp[pattern].cv_values[i1] = SCALES[index][i1];
-							print_dbg("\rNEW SCALE ");
-							print_dbg_ulong(index);
-						}
+static void key_curve_up(u8 x, u8 y, u8 z) {
+	u8 i1;
+	s16 delta;
 
-						scale_select = 0;
-						monomeFrameDirty++;
-					}
-					else {
-						if(z && y==4) {
-							edit_cv_step = x;
-							count = 0;
-							for(i1=0;i1<16;i1++)
-									if((w.wp[pattern].cv_steps[edit_cv_ch][edit_cv_step] >> i1) & 1) {
-										count++;
-										edit_cv_value = i1;
-									}
-							if(count>1)
-								edit_cv_value = -1;
-
-							keycount_cv = 0;
-
-							monomeFrameDirty++;
-						}
-						// load scale
-						else if(key_alt && y==7 && x == 0 && z) {
-							scale_select++;
-							monomeFrameDirty++;
-						}
-						// read pot					
-						else if(y==7 && key_alt && edit_cv_value != -1 && x==LENGTH) {
-							param_accept = z;
-							param_dest = &(w.wp[pattern].cv_values[edit_cv_value]);
-							// print_dbg("\r\nparam: ");
-							// print_dbg_ulong(*param_dest);
-						}
-						else if((y == 5 || y == 6) && z && x<4 && edit_cv_step != -1) {
-							delta = 0;
-	 						if(x == 0)
-								delta = 409;
-							else if(x == 1)
-								delta = 239;
-							else if(x == 2)
-								delta = 34;
-							else if(x == 3)
-								delta = 3;
-
-							if(y == 6)
-								delta *= -1;
-							
-							if(key_alt) {
-								for(i1=0;i1<16;i1++) {
-									if(w.wp[pattern].cv_values[i1] + delta > 4092)
-										w.wp[pattern].cv_values[i1] = 4092;
-									else if(delta < 0 && w.wp[pattern].cv_values[i1] < -1*delta)
-										w.wp[pattern].cv_values[i1] = 0;
-									else
-										w.wp[pattern].cv_values[i1] += delta;
-								}
-							}
-							else {
-								if(w.wp[pattern].cv_values[edit_cv_value] + delta > 4092)
-									w.wp[pattern].cv_values[edit_cv_value] = 4092;
-								else if(delta < 0 && w.wp[pattern].cv_values[edit_cv_value] < -1*delta)
-									w.wp[pattern].cv_values[edit_cv_value] = 0;
-								else
-									w.wp[pattern].cv_values[edit_cv_value] += delta;
-							}
-
-							monomeFrameDirty++;
-						}
-						// choose values
-						else if(y==7) {
-							keycount_cv += z*2-1;
-							if(keycount_cv < 0)
-								keycount_cv = 0;
-
-							if(z) {
-								count = 0;
-								for(i1=0;i1<16;i1++)
-									if((w.wp[pattern].cv_steps[edit_cv_ch][edit_cv_step] >> i1) & 1)
-										count++;
-
-								// single press toggle
-								if(keycount_cv == 1 && count < 2) {
-									w.wp[pattern].cv_steps[edit_cv_ch][edit_cv_step] = (1<<x);
-									edit_cv_value = x;
-								}
-								// multiselect
-								else if(keycount_cv > 1 || count > 1) {
-									w.wp[pattern].cv_steps[edit_cv_ch][edit_cv_step] ^= (1<<x);
-
-									if(!w.wp[pattern].cv_steps[edit_cv_ch][edit_cv_step])
-										w.wp[pattern].cv_steps[edit_cv_ch][edit_cv_step] = (1<<x);
-
-									count = 0;
-									for(i1=0;i1<16;i1++)
-										if((w.wp[pattern].cv_steps[edit_cv_ch][edit_cv_step] >> i1) & 1) {
-											count++;
-											edit_cv_value = i1;
-										}
-
-									if(count > 1)
-										edit_cv_value = -1;
-								}
-
-								monomeFrameDirty++;
-							}
-						}
-					}
-				}
-			}
-			else if(edit_prob == 1) {
-				if(z) {
-					if(y == 4) w.wp[pattern].cv_probs[edit_cv_ch][x] = 192;
-					else if(y == 5) w.wp[pattern].cv_probs[edit_cv_ch][x] = 128;
-					else if(y == 6) w.wp[pattern].cv_probs[edit_cv_ch][x] = 64;
-					else w.wp[pattern].cv_probs[edit_cv_ch][x] = 0;
-				}
-			}
+	if(!z)
+		return;
+
+	delta = curve_delta();
+	if(key_meta == 0) {
+		// saturate
+		if(w->wp[pattern].cv_curves[edit_cv_ch][x] + delta < 4092)
+			w->wp[pattern].cv_curves[edit_cv_ch][x] += delta;
+		else
+			w->wp[pattern].cv_curves[edit_cv_ch][x] = 4092;
+	}
+	else {
+		for(i1=0;i1<16;i1++) {
+			// saturate
+			if(w->wp[pattern].cv_curves[edit_cv_ch][i1] + delta < 4092)
+				w->wp[pattern].cv_curves[edit_cv_ch][i1] += delta;
+			else
+				w->wp[pattern].cv_curves[edit_cv_ch][i1] = 4092;
 		}
+	}
+}
 
-		// series mode
-		else if(edit_mode == mSeries) {
-			if(z && key_alt) {
-				if(x == 0)
-					series_next = y-2+scroll_pos;
-				else if(x == LENGTH-1)
-					w.series_start = y-2+scroll_pos;
-				else if(x == LENGTH)
-					w.series_end = y-2+scroll_pos;
-
-				if(w.series_end < w.series_start)
-					w.series_end = w.series_start;
-			}
-			else {
-				keycount_series += z*2-1;
-				if(keycount_series < 0)
-					keycount_series = 0;
-
-				if(z) {
-					count = 0;
-					for(i1=0;i1<16;i1++)
-						count += (w.series_list[y-2+scroll_pos] >> i1) & 1;
-
-					// single press toggle
-					if(keycount_series == 1 && count < 2) {
-						w.series_list[y-2+scroll_pos] = (1<<x);
-					}
-					// multi-select
-					else if(keycount_series > 1 || count > 1) {
-						w.series_list[y-2+scroll_pos] ^= (1<<x);
+static void key_curve_down(u8 x, u8 y, u8 z) {
+	u8 i1;
+	s16 delta;
 
-						// ensure not fully clear
-						if(!w.series_list[y-2+scroll_pos])
-							w.series_list[y-2+scroll_pos] = (1<<x);
-					}
-				}
-			}
+	if(!z)
+		return;
 
-			monomeFrameDirty++;
+	delta = curve_delta();
+	if(key_meta == 0) {
+		// saturate
+		if(w->wp[pattern].cv_curves[edit_cv_ch][x] > delta)
+			w->wp[pattern].cv_curves[edit_cv_ch][x] -= delta;
+		else
+			w->wp[pattern].cv_curves[edit_cv_ch][x] = 0;
+	}
+	else {
+		for(i1=0;i1<16;i1++) {
+			// saturate
+			if(w->wp[pattern].cv_curves[edit_cv_ch][i1] > delta)
+				w->wp[pattern].cv_curves[edit_cv_ch][i1] -= delta;
+			else
+				w->wp[pattern].cv_curves[edit_cv_ch][i1] = 0;
 		}
 	}
 }
 
-////////////////////////////////////////////////////////////////////////////////
-// application grid redraw
-static void refresh() {
-	u8 i1,i2;
+static void key_curve_clip(u8 x, u8 y, u8 z) {
+	if(z == 1) {
+		center = 1;
+		if(quantize_in)
+			quantize_in = 0;
+		else if(key_alt)
+			w->wp[pattern].cv_curves[edit_cv_ch][x] = clip;
+		else
+			clip = w->wp[pattern].cv_curves[edit_cv_ch][x];
+	}
+	else
+		center = 0;
+}
 
+static void key_curve_pot(u8 x, u8 y, u8 z) {
+	u8 i1;
 
-	// clear top, cut, pattern, prob
-	for(i1=0;i1<16;i1++) {
-		monomeLedBuffer[i1] = 0;
-		monomeLedBuffer[16+i1] = 0;
-		monomeLedBuffer[32+i1] = 4;
-		monomeLedBuffer[48+i1] = 0;
+	if(key_alt && z) {
+		param_dest = &w->wp[pattern].cv_curves[edit_cv_ch][pos];
+		w->wp[pattern].cv_curves[edit_cv_ch][pos] = (adc[1] / 34) * 34;
+		quantize_in = 1;
+		param_accept = 1;
+		live_in = 1;
 	}
-
-	// dim mode
-	if(edit_mode == mTrig) {
-		monomeLedBuffer[0] = 4;
-		monomeLedBuffer[1] = 4;
-		monomeLedBuffer[2] = 4;
-		monomeLedBuffer[3] = 4;
+	else if(center && z) {
+		if(key_meta == 0) 
+			w->wp[pattern].cv_curves[edit_cv_ch][x] = random_range(&rnd_edit, (adc[1] / 34) * 34 + 1);
+		else {
+			for(i1=0;i1<16;i1++) {
+				w->wp[pattern].cv_curves[edit_cv_ch][i1] = random_range(&rnd_edit, (adc[1] / 34) * 34 + 1);
+			}
+		}
 	}
-	else if(edit_mode == mMap) {
-		if(SIZE==16) {
-			monomeLedBuffer[4+(edit_cv_ch*4)] = 4;
-			monomeLedBuffer[5+(edit_cv_ch*4)] = 4;
-			monomeLedBuffer[6+(edit_cv_ch*4)] = 4;
-			monomeLedBuffer[7+(edit_cv_ch*4)] = 4;
+	else {
+		param_accept = z;
+		param_dest = &w->wp[pattern].cv_curves[edit_cv_ch][x];
+		if(z) {
+			w->wp[pattern].cv_curves[edit_cv_ch][x] = (adc[1] / 34) * 34;
+			quantize_in = 1;
 		}
 		else
-			monomeLedBuffer[4+edit_cv_ch] = 4;
-	}
-	else if(edit_mode == mSeries) {
-		monomeLedBuffer[LENGTH-1] = 7;
-	}
-
-	// alt
-	monomeLedBuffer[LENGTH] = 4;
-	if(key_alt) monomeLedBuffer[LENGTH] = 11;
-
-	// show mutes or on steps
-	if(key_meta) {
-		if(w.tr_mute[0]) monomeLedBuffer[0] = 11;
-		if(w.tr_mute[1]) monomeLedBuffer[1] = 11;
-		if(w.tr_mute[2]) monomeLedBuffer[2] = 11;
-		if(w.tr_mute[3]) monomeLedBuffer[3] = 11;
-	}
-	else if(triggered) {
-		if(triggered & 0x1 && w.tr_mute[0]) monomeLedBuffer[0] = 11 - 4 * w.wp[pattern].tr_mode;
-		if(triggered & 0x2 && w.tr_mute[1]) monomeLedBuffer[1] = 11 - 4 * w.wp[pattern].tr_mode;
-		if(triggered & 0x4 && w.tr_mute[2]) monomeLedBuffer[2] = 11 - 4 * w.wp[pattern].tr_mode;
-		if(triggered & 0x8 && w.tr_mute[3]) monomeLedBuffer[3] = 11 - 4 * w.wp[pattern].tr_mode;
-	}
-
-	// cv indication
-	if(key_meta) {
-		if(SIZE==16) {
-			if(w.cv_mute[0]) {
-				monomeLedBuffer[4] = 11;
-				monomeLedBuffer[5] = 11;
-				monomeLedBuffer[6] = 11;
-				monomeLedBuffer[7] = 11;
-			}
-			if(w.cv_mute[1]) {
-				monomeLedBuffer[8] = 11;
-				monomeLedBuffer[9] = 11;
-				monomeLedBuffer[10] = 11;
-				monomeLedBuffer[11] = 11;
+			quantize_in = 0;
+	}
+}
+
+// MAP
+static void key_scale(u8 x, u8 y, u8 z) {
+	u8 index, i1;
+
+	// index -= 64;
+	index = (y-4) * 8 + x;
+	if(index < 24 && y<8) {
+		for(i1=0;i1<16;i1++)
+			w->wp[pattern].cv_values[i1] = SCALES[index][i1];
+		print_dbg("\rNEW SCALE ");
+		print_dbg_ulong(index);
+	}
+
+	scale_select = 0;
+}
+
+static void key_map_step(u8 x, u8 y, u8 z) {
+	u8 count;
+
+	if(z) {
+		edit_cv_step = x;
+		count = bits_count(w->wp[pattern].cv_steps[edit_cv_ch][edit_cv_step]);
+		if(count == 1)
+			edit_cv_value = bits_nth(w->wp[pattern].cv_steps[edit_cv_ch][edit_cv_step], 0);
+		else if(count>1)
+			edit_cv_value = -1;
+
+		keycount_cv = 0;
+	}
+}
+
+static void key_map_nudge(u8 x, u8 y, u8 z) {
+	u8 i1;
+	s16 delta;
+
+	if(z && x<4 && edit_cv_step != -1) {
+		delta = 0;
+			if(x == 0)
+			delta = 409;
+		else if(x == 1)
+			delta = 239;
+		else if(x == 2)
+			delta = 34;
+		else if(x == 3)
+			delta = 3;
+
+		if(y == 6)
+			delta *= -1;
+		
+		if(key_alt) {
+			for(i1=0;i1<16;i1++) {
+				if(w->wp[pattern].cv_values[i1] + delta > 4092)
+					w->wp[pattern].cv_values[i1] = 4092;
+				else if(delta < 0 && w->wp[pattern].cv_values[i1] < -1*delta)
+					w->wp[pattern].cv_values[i1] = 0;
+				else
+					w->wp[pattern].cv_values[i1] += delta;
 			}
 		}
 		else {
-			if(w.cv_mute[0])
-				monomeLedBuffer[4] = 11;
-			if(w.cv_mute[1])
-				monomeLedBuffer[5] = 11;
+			if(w->wp[pattern].cv_values[edit_cv_value] + delta > 4092)
+				w->wp[pattern].cv_values[edit_cv_value] = 4092;
+			else if(delta < 0 && w->wp[pattern].cv_values[edit_cv_value] < -1*delta)
+				w->wp[pattern].cv_values[edit_cv_value] = 0;
+			else
+				w->wp[pattern].cv_values[edit_cv_value] += delta;
 		}
+	}
+}
+
+static void key_map_values(u8 x, u8 y, u8 z) {
+	u8 count;
 
+	// load scale
+	if(key_alt && x == 0 && z) {
+		scale_select++;
 	}
-	else if(SIZE==16) {
-		monomeLedBuffer[cv0 / 1024 + 4] = 11;
-		monomeLedBuffer[cv1 / 1024 + 8] = 11;
+	// read pot					
+	else if(key_alt && edit_cv_value != -1 && x==LENGTH) {
+		param_accept = z;
+		param_dest = &(w->wp[pattern].cv_values[edit_cv_value]);
+		// print_dbg("\r\nparam: ");
+		// print_dbg_ulong(*param_dest);
 	}
+	// choose values
+	else {
+		keycount_cv += z*2-1;
+		if(keycount_cv < 0)
+			keycount_cv = 0;
 
-	// show pos loop dim
-	if(w.wp[pattern].loop_dir) {	
-		for(i1=0;i1<SIZE;i1++) {
-			if(w.wp[pattern].loop_dir == 1 && i1 >= w.wp[pattern].loop_start && i1 <= w.wp[pattern].loop_end)
-				monomeLedBuffer[16+i1] = 4;
-			else if(w.wp[pattern].loop_dir == 2 && (i1 <= w.wp[pattern].loop_end || i1 >= w.wp[pattern].loop_start)) 
-				monomeLedBuffer[16+i1] = 4;
+		if(z) {
+			count = bits_count(w->wp[pattern].cv_steps[edit_cv_ch][edit_cv_step]);
+
+			// single press toggle
+			if(keycount_cv == 1 && count < 2) {
+				w->wp[pattern].cv_steps[edit_cv_ch][edit_cv_step] = (1<<x);
+				edit_cv_value = x;
+			}
+			// multiselect
+			else if(keycount_cv > 1 || count > 1) {
+				w->wp[pattern].cv_steps[edit_cv_ch][edit_cv_step] ^= (1<<x);
+
+				if(!w->wp[pattern].cv_steps[edit_cv_ch][edit_cv_step])
+					w->wp[pattern].cv_steps[edit_cv_ch][edit_cv_step] = (1<<x);
+
+				count = bits_count(w->wp[pattern].cv_steps[edit_cv_ch][edit_cv_step]);
+
+				if(count == 1)
+					edit_cv_value = bits_nth(w->wp[pattern].cv_steps[edit_cv_ch][edit_cv_step], 0);
+				else if(count > 1)
+					edit_cv_value = -1;
+			}
 		}
 	}
+}
 
-	// show position and next cut
-	if(cut_pos) monomeLedBuffer[16+next_pos] = 7;
-	monomeLedBuffer[16+pos] = 15;
+// series mode
+static void key_series(u8 x, u8 y, u8 z) {
+	u8 count;
 
-	// show pattern
-	monomeLedBuffer[32+pattern] = 11;
-	if(pattern != next_pattern) monomeLedBuffer[32+next_pattern] = 7;
+	if(z && key_alt) {
+		if(x == 0)
+			series_next = y-2+scroll_pos;
+		else if(x == LENGTH-1)
+			w->series_start = y-2+scroll_pos;
+		else if(x == LENGTH)
+			w->series_end = y-2+scroll_pos;
 
-	// show step data
-	if(edit_mode == mTrig) {
-		if(edit_prob == 0) {
-			for(i1=0;i1<SIZE;i1++) {
-	 			for(i2=0;i2<4;i2++) {
-					if((w.wp[pattern].steps[i1] & (1<<i2)) && i1 == pos && (triggered & 1<<i2) && w.tr_mute[i2]) monomeLedBuffer[(i2+4)*16+i1] = 11;
-					else if(w.wp[pattern].steps[i1] & (1<<i2) && (w.wp[pattern].step_choice & 1<<i1)) monomeLedBuffer[(i2+4)*16+i1] = 4;
-					else if(w.wp[pattern].steps[i1] & (1<<i2)) monomeLedBuffer[(i2+4)*16+i1] = 7;
-					else if(i1 == pos) monomeLedBuffer[(i2+4)*16+i1] = 4;
-					else monomeLedBuffer[(i2+4)*16+i1] = 0;
-				}
+		if(w->series_end < w->series_start)
+			w->series_end = w->series_start;
+	}
+	else {
+		keycount_series += z*2-1;
+		if(keycount_series < 0)
+			keycount_series = 0;
 
-				// probs
-				if(w.wp[pattern].step_probs[i1] == 255) monomeLedBuffer[48+i1] = 11;
-				else if(w.wp[pattern].step_probs[i1] > 0) monomeLedBuffer[48+i1] = 4;
+		if(z) {
+			count = bits_count(w->series_list[y-2+scroll_pos]);
+
+			// single press toggle
+			if(keycount_series == 1 && count < 2) {
+				w->series_list[y-2+scroll_pos] = (1<<x);
 			}
-		}
-		else if(edit_prob == 1) {
-			for(i1=0;i1<SIZE;i1++) {
-				monomeLedBuffer[64+i1] = 4;
-				monomeLedBuffer[80+i1] = 4;
-				monomeLedBuffer[96+i1] = 4;
-				monomeLedBuffer[112+i1] = 4;
-
-				if(w.wp[pattern].step_probs[i1] == 255)
-					monomeLedBuffer[48+i1] = 11;
-				else if(w.wp[pattern].step_probs[i1] == 0) {
-					monomeLedBuffer[48+i1] = 0;
-					monomeLedBuffer[112+i1] = 7;
-				}
-				else if(w.wp[pattern].step_probs[i1]) {
-					monomeLedBuffer[48+i1] = 4;
-					monomeLedBuffer[64+16*(3-(w.wp[pattern].step_probs[i1]>>6))+i1] = 7;
-				}
+			// multi-select
+			else if(keycount_series > 1 || count > 1) {
+				w->series_list[y-2+scroll_pos] ^= (1<<x);
+
+				// ensure not fully clear
+				if(!w->series_list[y-2+scroll_pos])
+					w->series_list[y-2+scroll_pos] = (1<<x);
 			}
 		}
 	}
+}
 
-	// show map
+// row handlers per view
+static const key_fn key_rows[kvViews][8] = {
+	[kvTrig] = {
+		key_top, key_pos, key_none, key_step_prob,
+		key_step, key_step, key_step, key_step
+	},
+	[kvTrigProb] = {
+		key_top, key_pos, key_step_level, key_step_prob,
+		key_step_level, key_step_level, key_step_level, key_step_level
+	},
+	[kvCurves] = {
+		key_top, key_pos, key_none, key_cv_prob,
+		key_curve_up, key_curve_clip, key_curve_down, key_curve_pot
+	},
+	[kvMap] = {
+		key_top, key_pos, key_none, key_cv_prob,
+		key_map_step, key_map_nudge, key_map_nudge, key_map_values
+	},
+	// a press while choosing a scale
+	[kvScale] = {
+		key_top, key_pos, key_scale, key_cv_prob,
+		key_scale, key_scale, key_scale, key_scale
+	},
+	[kvMapProb] = {
+		key_top, key_pos, key_cv_level, key_cv_prob,
+		key_cv_level, key_cv_level, key_cv_level, key_cv_level
+	},
+	[kvSeries] = {
+		key_top, key_pos, key_series, key_series,
+		key_series, key_series, key_series, key_series
+	},
+	[kvPreset] = {
+		key_glyph, key_glyph, key_glyph, key_glyph,
+		key_glyph, key_glyph, key_glyph, key_glyph
+	}
+};
+
+static u8 key_view(u8 z) {
+	if(preset_mode)
+		return kvPreset;
+	else if(edit_mode == mTrig)
+		return edit_prob ? kvTrigProb : kvTrig;
 	else if(edit_mode == mMap) {
-		if(edit_prob == 0) {
-			// CURVES
-			if(w.wp[pattern].cv_mode[edit_cv_ch] == 0) {
-				for(i1=0;i1<SIZE;i1++) {
-					// probs
-					if(w.wp[pattern].cv_probs[edit_cv_ch][i1] == 255) monomeLedBuffer[48+i1] = 11;
-					else if(w.wp[pattern].cv_probs[edit_cv_ch][i1] > 0) monomeLedBuffer[48+i1] = 7;
-
-					monomeLedBuffer[112+i1] = (w.wp[pattern].cv_curves[edit_cv_ch][i1] > 1023) * 7;
-					monomeLedBuffer[96+i1] = (w.wp[pattern].cv_curves[edit_cv_ch][i1] > 2047) * 7;
-					monomeLedBuffer[80+i1] = (w.wp[pattern].cv_curves[edit_cv_ch][i1] > 3071) * 7;
-					monomeLedBuffer[64+i1] = 0;
-					monomeLedBuffer[64+16*(3-(w.wp[pattern].cv_curves[edit_cv_ch][i1]>>10))+i1] = (w.wp[pattern].cv_curves[edit_cv_ch][i1]>>7) & 0x7;
-				}
+		if(edit_prob)
+			return kvMapProb;
+		else if(w->wp[pattern].cv_mode[edit_cv_ch] == 0)
+			return kvCurves;
+		else
+			return scale_select && z ? kvScale : kvMap;
+	}
+	else
+		return kvSeries;
+}
 
-				// play step highlight
-				monomeLedBuffer[64+pos] += 4;
-				monomeLedBuffer[80+pos] += 4;
-				monomeLedBuffer[96+pos] += 4;
-				monomeLedBuffer[112+pos] += 4;
-			}
-			// MAP
-			else {
-				if(!scale_select) {
-					for(i1=0;i1<SIZE;i1++) {
-						// probs
-						if(w.wp[pattern].cv_probs[edit_cv_ch][i1] == 255) monomeLedBuffer[48+i1] = 11;
-						else if(w.wp[pattern].cv_probs[edit_cv_ch][i1] > 0) monomeLedBuffer[48+i1] = 7;
+static void handler_MonomeGridKey(s32 data) { 
+	u8 x, y, z, index, i1;
+	monome_grid_key_parse_event_data(data, &x, &y, &z);
+	// print_dbg("\r\n monome event; x: "); 
+	// print_dbg_hex(x); 
+	// print_dbg("; y: 0x"); 
+	// print_dbg_hex(y); 
+	// print_dbg("; z: 0x"); 
+	// print_dbg_hex(z);
+	if(y > 7)
+		return;
 
-						// clear edit select line
-						monomeLedBuffer[64+i1] = 4;
+	step_edit();
 
-						// show current edit value, selected
-						if(edit_cv_value != -1) {
-							if((w.wp[pattern].cv_values[edit_cv_value] >> 8) >= i1)
-								monomeLedBuffer[80+i1] = 7;
-							else
-								monomeLedBuffer[80+i1] = 0;
-
-							if(((w.wp[pattern].cv_values[edit_cv_value] >> 4) & 0xf) >= i1)
-								monomeLedBuffer[96+i1] = 4;
-							else
-								monomeLedBuffer[96+i1] = 0;
-						}
-						else {
-							monomeLedBuffer[80+i1] = 0;
-							monomeLedBuffer[96+i1] = 0;
-						}
+	//// TRACK LONG PRESSES
+	index = y*16 + x;
+	if(z) {
+		hold_start(index, Get_sys_count() + cpu_ms_2_cy(KEY_HOLD_MS, FMCK_HZ));
+		key_arm();
+	} else {
+		// FAST PRESS
+		if(hold_cancel(index)) {
+			key_arm();
 
-						// show steps
-						if(w.wp[pattern].cv_steps[edit_cv_ch][edit_cv_step] & (1<<i1)) monomeLedBuffer[112+i1] = 7;
-						else monomeLedBuffer[112+i1] = 0;
+			if(edit_mode != mSeries && preset_mode == 0) {
+				if(index/16 == 2) {
+					i1 = index % 16;
+					if(key_alt)
+						next_pattern = i1;
+					else {
+						pattern = i1;
+						next_pattern = i1;
 					}
-
-					// show play position
-					monomeLedBuffer[64+pos] = 7;
-					// show edit position
-					monomeLedBuffer[64+edit_cv_step] = 11;
-					// show playing note
-					monomeLedBuffer[112+cv_chosen[edit_cv_ch]] = 11;
 				}
-				else {
-					for(i1=0;i1<SIZE;i1++) {
-						// probs
-						if(w.wp[pattern].cv_probs[edit_cv_ch][i1] == 255) monomeLedBuffer[48+i1] = 11;
-						else if(w.wp[pattern].cv_probs[edit_cv_ch][i1] > 0) monomeLedBuffer[48+i1] = 7;
-
-						monomeLedBuffer[64+i1] = (i1<8) * 4;						
-						monomeLedBuffer[80+i1] = (i1<8) * 4;						
-						monomeLedBuffer[96+i1] = (i1<8) * 4;						
-						monomeLedBuffer[112+i1] = 0;
-					}
-
-					monomeLedBuffer[112] = 7;
+			}
+			// PRESET MODE FAST PRESS DETECT
+			else if(preset_mode == 1) {
+				if(x == 0 && y != preset_select) {
+					preset_select = y;
+					glyph_load(preset_select);
 				}
+ 				else if(x==0 && y == preset_select) {
+					flash_read(preset_select, switchNow);
 
-			}
-		}
-		else if(edit_prob == 1) {
-			for(i1=0;i1<SIZE;i1++) {
-				monomeLedBuffer[64+i1] = 4;
-				monomeLedBuffer[80+i1] = 4;
-				monomeLedBuffer[96+i1] = 4;
-				monomeLedBuffer[112+i1] = 4;
-
-				if(w.wp[pattern].cv_probs[edit_cv_ch][i1] == 255)
-					monomeLedBuffer[48+i1] = 11;
-				else if(w.wp[pattern].cv_probs[edit_cv_ch][i1] == 0) {
-					monomeLedBuffer[48+i1] = 0;
-					monomeLedBuffer[112+i1] = 7;
+					preset_mode = 0;
 				}
-				else if(w.wp[pattern].cv_probs[edit_cv_ch][i1]) {
-					monomeLedBuffer[48+i1] = 4;
-					monomeLedBuffer[64+16*(3-(w.wp[pattern].cv_probs[edit_cv_ch][i1]>>6))+i1] = 7;
+				// queue the row's preset for the end of the playing pattern
+				else if(x == 1) {
+					flash_read(y, switchPattern);
+
+					preset_mode = 0;
 				}
 			}
+			// print_dbg("\r\nfast press: ");
+			// print_dbg_ulong(index);
 		}
-
 	}
 
-	// series
-	else if(edit_mode == mSeries) {
-		for(i1 = 0;i1<6;i1++) {
-			for(i2=0;i2<SIZE;i2++) {
-				// start/end bars, clear
-				if(i1+scroll_pos == w.series_start || i1+scroll_pos == w.series_end) monomeLedBuffer[32+i1*16+i2] = 4;
-				else monomeLedBuffer[32+i1*16+i2] = 0;
-			}
+	(*key_rows[key_view(z)][y])(x, y, z);
 
-			// scroll position helper
-			monomeLedBuffer[32+i1*16+((scroll_pos+i1)/(64/SIZE))] = 4;
-			
-			// sidebar selection indicators
-			if(i1+scroll_pos > w.series_start && i1+scroll_pos < w.series_end) {
-				monomeLedBuffer[32+i1*16] = 4;
-				monomeLedBuffer[32+i1*16+LENGTH] = 4;
-			}
+	// redraw the rows this key can have changed
+	if(preset_mode || y == 0 || (y == 2 && edit_mode != mSeries))
+		grid_dirty(GRID_ALL);
+	else if(y == 1)
+		grid_dirty(GRID_POS);
+	else
+		grid_dirty(GRID_PATTERN | GRID_EDIT);
 
-			for(i2=0;i2<SIZE;i2++) {
-				// show possible states
-				if((w.series_list[i1+scroll_pos] >> i2) & 1)
-					monomeLedBuffer[32+(i1*16)+i2] = 7;
-			}
+	// answer keys without waiting for the frame timer
+	queue_post(kEventMonomeRefresh, 0);
 
-		}
+	step_edit_done();
 
-		// highlight playhead
-		if(series_pos >= scroll_pos && series_pos < scroll_pos+6) {
-			monomeLedBuffer[32+(series_pos-scroll_pos)*16+series_playing] = 11;
-		}
+	latency_add(&lat_key, Get_sys_count() - key_read_at);
+	// timed from the oldest key the next frame answers
+	if(!key_led_pending) {
+		key_led_at = key_read_at;
+		key_led_pending = 1;
 	}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// application grid redraw
 
-	monome_set_quadrant_flag(0);
-	monome_set_quadrant_flag(1);
+// mark rows for the next refresh. the clock calls this from its interrupt
+static void grid_dirty(u16 rows) {
+	irqflags_t flags = cpu_irq_save();
+	grid_rows |= rows;
+	refresh_wake();
+	cpu_irq_restore(flags);
 }
 
+// take the dirty rows, and the playing state to draw them from
+static u16 grid_take(void) {
+	u16 rows;
+	irqflags_t flags = cpu_irq_save();
 
-// application grid redraw without varibright
-static void refresh_mono() {
-	u8 i1,i2;
+	rows = grid_rows;
+	grid_rows = 0;
+	play_save(&view);
+	cpu_irq_restore(flags);
 
-	// clear top, cut, pattern, prob
-	for(i1=0;i1<16;i1++) {
-		monomeLedBuffer[i1] = 0;
-		monomeLedBuffer[16+i1] = 0;
-		monomeLedBuffer[32+i1] = 0;
-		monomeLedBuffer[48+i1] = 0;
-	}
+	// series rows cover the pattern row
+	if(edit_mode == mSeries && (rows & (GRID_PATTERN | GRID_EDIT)))
+		rows |= GRID_PATTERN | GRID_EDIT;
 
-	// show mode
-	if(edit_mode == mTrig) {
-		monomeLedBuffer[0] = 11;
-		monomeLedBuffer[1] = 11;
-		monomeLedBuffer[2] = 11;
-		monomeLedBuffer[3] = 11;
-	}
-	else if(edit_mode == mMap) {
-		if(SIZE==16) {
-			monomeLedBuffer[4+(edit_cv_ch*4)] = 11;
-			monomeLedBuffer[5+(edit_cv_ch*4)] = 11;
-			monomeLedBuffer[6+(edit_cv_ch*4)] = 11;
-			monomeLedBuffer[7+(edit_cv_ch*4)] = 11;
-		}
-		else
-			monomeLedBuffer[4+edit_cv_ch] = 11;
-	}
-	else if(edit_mode == mSeries) {
-		monomeLedBuffer[LENGTH-1] = 11;
-	}
-
-	if(key_meta) {
-		monomeLedBuffer[0] = 11 * w.tr_mute[0];
-		monomeLedBuffer[1] = 11 * w.tr_mute[1];
-		monomeLedBuffer[2] = 11 * w.tr_mute[2];
-		monomeLedBuffer[3] = 11 * w.tr_mute[3];
-
-		if(SIZE == 16) {
-			monomeLedBuffer[4] = 11 * w.cv_mute[0];
-			monomeLedBuffer[5] = 11 * w.cv_mute[0];
-			monomeLedBuffer[6] = 11 * w.cv_mute[0];
-			monomeLedBuffer[7] = 11 * w.cv_mute[0];
-			monomeLedBuffer[8] = 11 * w.cv_mute[1];
-			monomeLedBuffer[9] = 11 * w.cv_mute[1];
-			monomeLedBuffer[10] = 11 * w.cv_mute[1];
-			monomeLedBuffer[11] = 11 * w.cv_mute[1];
-		} else {
-			monomeLedBuffer[4] = 11 * w.cv_mute[0];
-			monomeLedBuffer[5] = 11 * w.cv_mute[1];
-		}
+	return rows;
+}
 
+// paint one led with the palette level for a state
+static inline void led(u8 i, led_state s) {
+	if(pal->level[s] != LED_HIDE)
+		monomeLedBuffer[i] = pal->level[s];
+}
 
-	}
+// probability edit view of columns x0 to x1-1: a level per column
+static void refresh_probs(const u8 *probs, u8 x0, u8 x1) {
+	u8 i1;
 
-	// alt
-	if(key_alt) monomeLedBuffer[LENGTH] = 11;
+	for(i1=x0;i1<x1;i1++) {
+		led(64+i1, ledProbBg);
+		led(80+i1, ledProbBg);
+		led(96+i1, ledProbBg);
+		led(112+i1, ledProbBg);
+
+		if(probs[i1] == 255)
+			led(48+i1, ledProbFull);
+		else if(probs[i1] == 0) {
+			led(48+i1, ledOff);
+			led(112+i1, ledProbLevel);
+		}
+		else {
+			led(48+i1, ledProbSome);
+			led(64+16*(3-(probs[i1]>>6))+i1, ledProbLevel);
+		}
+	}
+}
 
-	// show position
-	monomeLedBuffer[16+pos] = 15;
+// trig and map views, probabilities and edit rows, columns x0 to x1-1
+static void refresh_edit(u8 x0, u8 x1) {
+	u8 i1,i2,f;
+	u16 c;
+	led_state s;
 
-	// show pattern
-	monomeLedBuffer[32+pattern] = 11;
+	// clear prob
+	for(i1=x0;i1<x1;i1++)
+		monomeLedBuffer[48+i1] = 0;
 
 	// show step data
 	if(edit_mode == mTrig) {
 		if(edit_prob == 0) {
-			for(i1=0;i1<SIZE;i1++) {
+			for(i1=x0;i1<x1;i1++) {
 	 			for(i2=0;i2<4;i2++) {
-					if(w.wp[pattern].steps[i1] & (1<<i2)) monomeLedBuffer[(i2+4)*16+i1] = 11;
-					else monomeLedBuffer[(i2+4)*16+i1] = 0;
+					if((w->wp[view.pattern].steps[i1] & (1<<i2)) && i1 == view.pos && (view.triggered & 1<<i2) && w->tr_mute[i2]) s = ledStepFired;
+					else if(w->wp[view.pattern].steps[i1] & (1<<i2) && (w->wp[view.pattern].step_choice & 1<<i1)) s = ledStepChoice;
+					else if(w->wp[view.pattern].steps[i1] & (1<<i2)) s = ledStepOn;
+					else if(i1 == view.pos) s = ledStepPlay;
+					else s = ledOff;
+					led((i2+4)*16+i1, s);
 				}
 
 				// probs
-				if(w.wp[pattern].step_probs[i1] > 0) monomeLedBuffer[48+i1] = 11;
-			}
-		}
-		else if(edit_prob == 1) {
-			for(i1=0;i1<SIZE;i1++) {
-				monomeLedBuffer[64+i1] = 0;
-				monomeLedBuffer[80+i1] = 0;
-				monomeLedBuffer[96+i1] = 0;
-				monomeLedBuffer[112+i1] = 0;
-
-				if(w.wp[pattern].step_probs[i1] == 255)
-					monomeLedBuffer[48+i1] = 11;
-				else if(w.wp[pattern].step_probs[i1] == 0) {
-					monomeLedBuffer[48+i1] = 0;
-					monomeLedBuffer[112+i1] = 11;
-				}
-				else if(w.wp[pattern].step_probs[i1]) {
-					monomeLedBuffer[48+i1] = 11;
-					monomeLedBuffer[64+16*(3-(w.wp[pattern].step_probs[i1]>>6))+i1] = 11;
-				}
+				if(w->wp[view.pattern].step_probs[i1] == 255) led(48+i1, ledProbFull);
+				else if(w->wp[view.pattern].step_probs[i1] > 0) led(48+i1, ledProbSome);
 			}
 		}
+		else if(edit_prob == 1)
+			refresh_probs(w->wp[view.pattern].step_probs, x0, x1);
 	}
 
 	// show map
 	else if(edit_mode == mMap) {
 		if(edit_prob == 0) {
 			// CURVES
-			if(w.wp[pattern].cv_mode[edit_cv_ch] == 0) {
-				for(i1=0;i1<SIZE;i1++) {
+			if(w->wp[view.pattern].cv_mode[edit_cv_ch] == 0) {
+				for(i1=x0;i1<x1;i1++) {
 					// probs
-					if(w.wp[pattern].cv_probs[edit_cv_ch][i1] > 0) monomeLedBuffer[48+i1] = 11;
-
-					monomeLedBuffer[112+i1] = (w.wp[pattern].cv_curves[edit_cv_ch][i1] > 511) * 11;
-					monomeLedBuffer[96+i1] = (w.wp[pattern].cv_curves[edit_cv_ch][i1] > 1535) * 11;
-					monomeLedBuffer[80+i1] = (w.wp[pattern].cv_curves[edit_cv_ch][i1] > 2559) * 11;
-					monomeLedBuffer[64+i1] = (w.wp[pattern].cv_curves[edit_cv_ch][i1] > 3583) * 11;
+					if(w->wp[view.pattern].cv_probs[edit_cv_ch][i1] == 255) led(48+i1, ledProbFull);
+					else if(w->wp[view.pattern].cv_probs[edit_cv_ch][i1] > 0) led(48+i1, ledCvProbSome);
+
+					// bottom up, a row per 1024
+					c = w->wp[view.pattern].cv_curves[edit_cv_ch][i1];
+					for(i2=0;i2<4;i2++) {
+						if(c >= (i2+1) * 1024) f = 8;
+						else if(c > i2 * 1024) f = (c - i2 * 1024) >> 7;
+						else f = 0;
+						monomeLedBuffer[112-16*i2+i1] = pal->curve[i1 == view.pos][f];
+					}
 				}
 			}
 			// MAP
 			else {
 				if(!scale_select) {
-					for(i1=0;i1<SIZE;i1++) {
+					for(i1=x0;i1<x1;i1++) {
 						// probs
-						if(w.wp[pattern].cv_probs[edit_cv_ch][i1] > 0) monomeLedBuffer[48+i1] = 11;
+						if(w->wp[view.pattern].cv_probs[edit_cv_ch][i1] == 255) led(48+i1, ledProbFull);
+						else if(w->wp[view.pattern].cv_probs[edit_cv_ch][i1] > 0) led(48+i1, ledCvProbSome);
 
-						// clear edit row
-						monomeLedBuffer[64+i1] = 0;
+						// clear edit select line
+						led(64+i1, ledMapRow);
 
 						// show current edit value, selected
 						if(edit_cv_value != -1) {
-							if((w.wp[pattern].cv_values[edit_cv_value] >> 8) >= i1)
-								monomeLedBuffer[80+i1] = 11;
-							else
-								monomeLedBuffer[80+i1] = 0;
-
-							if(((w.wp[pattern].cv_values[edit_cv_value] >> 4) & 0xf) >= i1)
-								monomeLedBuffer[96+i1] = 11;
-							else
-								monomeLedBuffer[96+i1] = 0;
+							led(80+i1, (w->wp[view.pattern].cv_values[edit_cv_value] >> 8) >= i1 ? ledMapCoarse : ledOff);
+							led(96+i1, ((w->wp[view.pattern].cv_values[edit_cv_value] >> 4) & 0xf) >= i1 ? ledMapFine : ledOff);
 						}
 						else {
-							monomeLedBuffer[80+i1] = 0;
-							monomeLedBuffer[96+i1] = 0;
+							led(80+i1, ledOff);
+							led(96+i1, ledOff);
 						}
 
 						// show steps
-						if(w.wp[pattern].cv_steps[edit_cv_ch][edit_cv_step] & (1<<i1)) monomeLedBuffer[112+i1] = 11;
-						else monomeLedBuffer[112+i1] = 0;
+						led(112+i1, w->wp[view.pattern].cv_steps[edit_cv_ch][edit_cv_step] & (1<<i1) ? ledMapStep : ledOff);
 					}
 
+					// show play position
+					if(view.pos >= x0 && view.pos < x1)
+						led(64+view.pos, ledMapPlay);
 					// show edit position
-					monomeLedBuffer[64+edit_cv_step] = 11;
+					if(edit_cv_step >= x0 && edit_cv_step < x1)
+						led(64+edit_cv_step, ledMapEdit);
 					// show playing note
-					monomeLedBuffer[112+cv_chosen[edit_cv_ch]] = 11;
+					if(view.cv_chosen[edit_cv_ch] >= x0 && view.cv_chosen[edit_cv_ch] < x1)
+						led(112+view.cv_chosen[edit_cv_ch], ledMapNote);
 				}
 				else {
-					for(i1=0;i1<SIZE;i1++) {
+					for(i1=x0;i1<x1;i1++) {
 						// probs
-						if(w.wp[pattern].cv_probs[edit_cv_ch][i1] > 0) monomeLedBuffer[48+i1] = 11;
-
-						monomeLedBuffer[64+i1] = 0;						
-						monomeLedBuffer[80+i1] = 0;						
-						monomeLedBuffer[96+i1] = 0;						
-						monomeLedBuffer[112+i1] = 0;
+						if(w->wp[view.pattern].cv_probs[edit_cv_ch][i1] == 255) led(48+i1, ledProbFull);
+						else if(w->wp[view.pattern].cv_probs[edit_cv_ch][i1] > 0) led(48+i1, ledCvProbSome);
+
+						s = i1 < 8 ? ledScaleSlot : ledOff;
+						led(64+i1, s);
+						led(80+i1, s);
+						led(96+i1, s);
+						led(112+i1, ledOff);
 					}
 
-					monomeLedBuffer[112] = 11;
+					if(x0 == 0)
+						led(112, ledScaleCursor);
 				}
 
 			}
 		}
-		else if(edit_prob == 1) {
+		else if(edit_prob == 1)
+			refresh_probs(w->wp[view.pattern].cv_probs[edit_cv_ch], x0, x1);
+	}
+
+	grid_pos = view.pos;
+	grid_note = view.cv_chosen[edit_cv_ch];
+}
+
+// clock ticks in trig and map views: redraw only the edit columns the
+// playhead and playing note moved from and to
+static void grid_play(void) {
+	u8 c[4], i1, i2;
+
+	c[0] = grid_pos;
+	c[1] = view.pos;
+	c[2] = grid_note;
+	c[3] = view.cv_chosen[edit_cv_ch];
+
+	for(i1=0;i1<4;i1++) {
+		for(i2=0;i2<i1;i2++)
+			if(c[i2] == c[i1])
+				break;
+		if(i2 == i1 && c[i1] < SIZE)
+			refresh_edit(c[i1], c[i1] + 1);
+	}
+}
+
+static void refresh() {
+	u8 i1,i2;
+	u16 rows;
+	led_state s;
+
+	rows = grid_take();
+
+	if(rows & GRID_TOP) {
+		// clear top
+		for(i1=0;i1<16;i1++)
+			monomeLedBuffer[i1] = 0;
+
+		// show mode
+		if(edit_mode == mTrig) {
+			for(i1=0;i1<4;i1++)
+				led(i1, ledMode);
+		}
+		else if(edit_mode == mMap) {
+			for(i1=0;i1<lay->cv_w;i1++)
+				led(lay->cv_x[edit_cv_ch]+i1, ledMode);
+		}
+		else if(edit_mode == mSeries) {
+			led(LENGTH-1, ledSeriesMode);
+		}
+
+		// alt
+		led(LENGTH, key_alt ? ledAltHeld : ledAlt);
+
+		// show mutes or on steps
+		if(key_meta) {
+			for(i1=0;i1<4;i1++)
+				led(i1, w->tr_mute[i1] ? ledMuteOn : ledMuteOff);
+			for(i1=0;i1<lay->cv_w;i1++) {
+				led(lay->cv_x[0]+i1, w->cv_mute[0] ? ledMuteOn : ledMuteOff);
+				led(lay->cv_x[1]+i1, w->cv_mute[1] ? ledMuteOn : ledMuteOff);
+			}
+		}
+		else {
+			for(i1=0;i1<4;i1++)
+				if((view.triggered & (1<<i1)) && w->tr_mute[i1])
+					led(i1, w->wp[view.pattern].tr_mode ? ledGate : ledTrig);
+
+			// cv indication
+			if(lay->cv_meter) {
+				led(lay->cv_x[0] + view.cv0 / 1024, ledCv);
+				led(lay->cv_x[1] + view.cv1 / 1024, ledCv);
+			}
+		}
+	}
+
+	if(rows & GRID_POS) {
+		// clear cut
+		for(i1=0;i1<16;i1++)
+			monomeLedBuffer[16+i1] = 0;
+
+		// show view.pos loop dim
+		if(w->wp[view.pattern].loop_dir) {	
 			for(i1=0;i1<SIZE;i1++) {
-				monomeLedBuffer[64+i1] = 0;
-				monomeLedBuffer[80+i1] = 0;
-				monomeLedBuffer[96+i1] = 0;
-				monomeLedBuffer[112+i1] = 0;
-
-				if(w.wp[pattern].cv_probs[edit_cv_ch][i1] == 255)
-					monomeLedBuffer[48+i1] = 11;
-				else if(w.wp[pattern].cv_probs[edit_cv_ch][i1] == 0) {
-					monomeLedBuffer[48+i1] = 0;
-					monomeLedBuffer[112+i1] = 11;
-				}
-				else if(w.wp[pattern].cv_probs[edit_cv_ch][i1]) {
-					monomeLedBuffer[48+i1] = 11;
-					monomeLedBuffer[64+16*(3-(w.wp[pattern].cv_probs[edit_cv_ch][i1]>>6))+i1] = 11;
-				}
+				if(w->wp[view.pattern].loop_dir == 1 && i1 >= w->wp[view.pattern].loop_start && i1 <= w->wp[view.pattern].loop_end)
+					led(16+i1, ledLoop);
+				else if(w->wp[view.pattern].loop_dir == 2 && (i1 <= w->wp[view.pattern].loop_end || i1 >= w->wp[view.pattern].loop_start)) 
+					led(16+i1, ledLoop);
 			}
 		}
 
+		// show position and next cut
+		if(view.cut_pos) led(16+view.next_pos, ledCut);
+		led(16+view.pos, ledPos);
 	}
 
-	// series
-	else if(edit_mode == mSeries) {
-		for(i1 = 0;i1<6;i1++) {
-			for(i2=0;i2<SIZE;i2++) {
-				// start/end bars, clear
-				if((key_meta || key_alt) && (i1+scroll_pos == w.series_start || i1+scroll_pos == w.series_end)) monomeLedBuffer[32+i1*16+i2] = 11;
-				else monomeLedBuffer[32+i1*16+i2] = 0;
-			}
+	if(rows & GRID_PATTERN) {
+		// clear view.pattern
+		for(i1=0;i1<16;i1++)
+			led(32+i1, ledPatternBg);
+
+		// show view.pattern
+		led(32+view.pattern, ledPattern);
+		if(view.pattern != view.next_pattern) led(32+view.next_pattern, ledPatternNext);
+	}
+
+	if(rows & GRID_EDIT) {
+		// series
+		if(edit_mode == mSeries) {
+			// start/end bars stand out while they can be edited
+			s = key_meta || key_alt ? ledSeriesRange : ledSeriesBar;
+
+			for(i1 = 0;i1<6;i1++) {
+				for(i2=0;i2<SIZE;i2++) {
+					// start/end bars, clear
+					if(i1+scroll_pos == w->series_start || i1+scroll_pos == w->series_end) led(32+i1*16+i2, s);
+					else monomeLedBuffer[32+i1*16+i2] = 0;
+				}
 
-			// scroll position helper
-			// monomeLedBuffer[32+i1*16+((scroll_pos+i1)/(64/SIZE))] = 4;
+				// scroll position helper
+				led(32+i1*16+((scroll_pos+i1)/(64/SIZE)), ledSeriesScroll);
 			
-			// sidebar selection indicators
-			if((key_meta || key_alt) && i1+scroll_pos > w.series_start && i1+scroll_pos < w.series_end) {
-				monomeLedBuffer[32+i1*16] = 11;
-				monomeLedBuffer[32+i1*16+LENGTH] = 11;
-			}
+				// sidebar selection indicators
+				if(i1+scroll_pos > w->series_start && i1+scroll_pos < w->series_end) {
+					led(32+i1*16, s);
+					led(32+i1*16+LENGTH, s);
+				}
 
-			for(i2=0;i2<SIZE;i2++) {
-				// show possible states
-				if((w.series_list[i1+scroll_pos] >> i2) & 1)
-					monomeLedBuffer[32+(i1*16)+i2] = 11;
-			}
+				for(i2=0;i2<SIZE;i2++) {
+					// show possible states
+					if((w->series_list[i1+scroll_pos] >> i2) & 1)
+						led(32+(i1*16)+i2, ledSeriesOn);
+				}
 
-		}
+			}
 
-		// highlight playhead
-		if(series_pos >= scroll_pos && series_pos < scroll_pos+6 && (pos & 1)) {
-			monomeLedBuffer[32+(series_pos-scroll_pos)*16+series_playing] = 0;
+			// highlight playhead
+			if(view.series_pos >= scroll_pos && view.series_pos < scroll_pos+6) {
+				led(32+(view.series_pos-scroll_pos)*16+view.series_playing, view.pos & 1 ? ledSeriesPlayOdd : ledSeriesPlay);
+			}
 		}
+		else
+			refresh_edit(0, SIZE);
 	}
-
-	monome_set_quadrant_flag(0);
-	monome_set_quadrant_flag(1);
+	else if(rows & GRID_PLAY)
+		grid_play();
 }
 
 
 static void refresh_preset() {
 	u8 i1,i2;
 
+	// everything is redrawn on leaving the preset screen
+	grid_rows = 0;
+
 	for(i1=0;i1<128;i1++)
 		monomeLedBuffer[i1] = 0;
 
-	monomeLedBuffer[preset_select * 16] = 11;
+	led(preset_select * 16, ledPreset);
 
 	for(i1=0;i1<8;i1++)
 		for(i2=0;i2<8;i2++)
 			if(glyph[i1] & (1<<i2))
-				monomeLedBuffer[i1*16+i2+8] = 11;
-
-	monome_set_quadrant_flag(0);
-	monome_set_quadrant_flag(1);
+				led(i1*16+i2+8, ledPreset);
 }
 
 
@@ -1822,102 +2299,112 @@ static void ww_process_ii(uint8_t *data, uint8_t l) {
 	i = data[0];
 	d = (data[1] << 8) + data[2];
 
+	step_edit();
 	switch(i) {
 		case WW_PRESET:
 			if(d<0 || d>7)
 				break;
-			preset_select = d;
-			flash_read();
+			queue_ring_post(&queue_ii, kEventII, d);
 			break;
 		case WW_POS:
 			if(d<0 || d>15)
 				break;
 			next_pos = d;
 			cut_pos++;
-			monomeFrameDirty++;
+			grid_dirty(GRID_POS);
 			break;
 		case WW_SYNC:
 			if(d<0 || d>15)
 				break;
 			next_pos = d;
 			cut_pos++;
-			timer_set(&clockTimer,clock_time);
+			step_invalidate();
+			tempo_sync();
 			clock_phase = 1;
-			(*clock_pulse)(clock_phase);
+			clock_edge_at = Get_sys_count();
+			clock_masked(clock_phase);
 			break;
 		case WW_START:
 			if(d<0 || d>15)
 				break;
-			w.wp[pattern].loop_start = d;
- 			if(w.wp[pattern].loop_start > w.wp[pattern].loop_end) w.wp[pattern].loop_dir = 2;
- 			else if(w.wp[pattern].loop_start == 0 && w.wp[pattern].loop_end == LENGTH) w.wp[pattern].loop_dir = 0;
- 			else w.wp[pattern].loop_dir = 1;
+			w->wp[pattern].loop_start = d;
+ 			if(w->wp[pattern].loop_start > w->wp[pattern].loop_end) w->wp[pattern].loop_dir = 2;
+ 			else if(w->wp[pattern].loop_start == 0 && w->wp[pattern].loop_end == LENGTH) w->wp[pattern].loop_dir = 0;
+ 			else w->wp[pattern].loop_dir = 1;
 
- 			w.wp[pattern].loop_len = w.wp[pattern].loop_end - w.wp[pattern].loop_start;
+ 			w->wp[pattern].loop_len = w->wp[pattern].loop_end - w->wp[pattern].loop_start;
 
- 			if(w.wp[pattern].loop_dir == 2)
- 				w.wp[pattern].loop_len = (LENGTH - w.wp[pattern].loop_start) + w.wp[pattern].loop_end + 1;
- 			monomeFrameDirty++;
+ 			if(w->wp[pattern].loop_dir == 2)
+ 				w->wp[pattern].loop_len = (LENGTH - w->wp[pattern].loop_start) + w->wp[pattern].loop_end + 1;
+ 			grid_dirty(GRID_POS);
 			break;
 		case WW_END:
 			if(d<0 || d>15)
 				break;
-			w.wp[pattern].loop_end = d;
- 			if(w.wp[pattern].loop_start > w.wp[pattern].loop_end) w.wp[pattern].loop_dir = 2;
- 			else if(w.wp[pattern].loop_start == 0 && w.wp[pattern].loop_end == LENGTH) w.wp[pattern].loop_dir = 0;
- 			else w.wp[pattern].loop_dir = 1;
+			w->wp[pattern].loop_end = d;
+ 			if(w->wp[pattern].loop_start > w->wp[pattern].loop_end) w->wp[pattern].loop_dir = 2;
+ 			else if(w->wp[pattern].loop_start == 0 && w->wp[pattern].loop_end == LENGTH) w->wp[pattern].loop_dir = 0;
+ 			else w->wp[pattern].loop_dir = 1;
 
- 			w.wp[pattern].loop_len = w.wp[pattern].loop_end - w.wp[pattern].loop_start;
+ 			w->wp[pattern].loop_len = w->wp[pattern].loop_end - w->wp[pattern].loop_start;
 
- 			if(w.wp[pattern].loop_dir == 2)
- 				w.wp[pattern].loop_len = (LENGTH - w.wp[pattern].loop_start) + w.wp[pattern].loop_end + 1;
- 			monomeFrameDirty++;
+ 			if(w->wp[pattern].loop_dir == 2)
+ 				w->wp[pattern].loop_len = (LENGTH - w->wp[pattern].loop_start) + w->wp[pattern].loop_end + 1;
+ 			grid_dirty(GRID_POS);
  			break;
  		case WW_PMODE:
 	 		if(d<mForward || d>mPingRep)
 				break;
- 			w.wp[pattern].step_mode = d;
+ 			w->wp[pattern].step_mode = d;
  			break;
  		case WW_PATTERN:
  			if(d<0 || d>15)
 				break;
  			pattern = d;
 			next_pattern = d;
-			monomeFrameDirty++;
+			grid_dirty(GRID_ALL);
  			break;
  		case WW_QPATTERN:
 	 		if(d<0 || d>15)
 				break;
  			next_pattern = d;
- 			monomeFrameDirty++;
+ 			grid_dirty(GRID_PATTERN);
  			break;
  		case WW_MUTE1:
- 			if(d) w.tr_mute[0] = 1;
- 			else w.tr_mute[0] = 0;
+ 			if(d) w->tr_mute[0] = 1;
+ 			else w->tr_mute[0] = 0;
+ 			grid_dirty(GRID_TOP | GRID_EDIT);
  			break;
  		case WW_MUTE2:
- 			if(d) w.tr_mute[1] = 1;
- 			else w.tr_mute[1] = 0;
+ 			if(d) w->tr_mute[1] = 1;
+ 			else w->tr_mute[1] = 0;
+ 			grid_dirty(GRID_TOP | GRID_EDIT);
  			break;
  		case WW_MUTE3:
- 			if(d) w.tr_mute[2] = 1;
- 			else w.tr_mute[2] = 0;
+ 			if(d) w->tr_mute[2] = 1;
+ 			else w->tr_mute[2] = 0;
+ 			grid_dirty(GRID_TOP | GRID_EDIT);
  			break;
  		case WW_MUTE4:
- 			if(d) w.tr_mute[3] = 1;
- 			else w.tr_mute[3] = 0;
+ 			if(d) w->tr_mute[3] = 1;
+ 			else w->tr_mute[3] = 0;
+ 			grid_dirty(GRID_TOP | GRID_EDIT);
  			break;
  		case WW_MUTEA:
- 			if(d) w.cv_mute[0] = 1;
- 			else w.cv_mute[0] = 0;
+ 			if(d) w->cv_mute[0] = 1;
+ 			else w->cv_mute[0] = 0;
+ 			grid_dirty(GRID_TOP);
  			break;
  		case WW_MUTEB:
- 			if(d) w.cv_mute[1] = 1;
- 			else w.cv_mute[1] = 0;
+ 			if(d) w->cv_mute[1] = 1;
+ 			else w->cv_mute[1] = 0;
+ 			grid_dirty(GRID_TOP);
  			break;
 		default:
 			break;
 	}
+
+	step_edit_done();
   // print_dbg("\r\nmp: ");
   // print_dbg_ulong(i);
   // print_dbg(" ");
@@ -1934,6 +2421,7 @@ static inline void assign_main_event_handlers(void) {
 	app_event_handlers[ kEventPollADC ]	= &handler_PollADC;
 	app_event_handlers[ kEventKeyTimer ] = &handler_KeyTimer;
 	app_event_handlers[ kEventSaveFlash ] = &handler_SaveFlash;
+	app_event_handlers[ kEventII ] = &handler_II;
 	app_event_handlers[ kEventClockNormal ] = &handler_ClockNormal;
 	app_event_handlers[ kEventClockExt ] = &handler_ClockExt;
 	app_event_handlers[ kEventFtdiConnect ]	= &handler_FtdiConnect ;
@@ -1948,7 +2436,7 @@ static inline void assign_main_event_handlers(void) {
 // app event loop
 void check_events(void) {
 	static event_t e;
-	if( event_next(&e) ) {
+	if( queue_next(&e) ) {
 		(app_event_handlers)[e.type](e.data);
 	}
 }
@@ -1961,63 +2449,137 @@ u8 flash_is_fresh(void) {
   // flashc_memset((void *)nvram_data, 0x00, 8, sizeof(*nvram_data), true);
 }
 
-// write fresh status
-void flash_unfresh(void) {
-  flashc_memset8((void*)&(flashy.fresh), FIRSTRUN_KEY, 4, true);
-}
-
+// stage the preset and start appending it; handler_SaveFlash feeds the pages.
+// a save still paging keeps its buffer, and this one waits behind it
 void flash_write(void) {
 	// print_dbg("\r write preset ");
 	// print_dbg_ulong(preset_select);
-	flashc_memcpy((void *)&flashy.w[preset_select], &w, sizeof(w), true);
-	flashc_memcpy((void *)&flashy.glyph[preset_select], &glyph, sizeof(glyph), true);
-	flashc_memset8((void*)&(flashy.preset_select), preset_select, 1, true);
-	flashc_memset32((void*)&(flashy.edit_mode), edit_mode, 4, true);
+
+	save = &saves[journal_uses(&saves[0])];
+	save->w = *w;
+	memcpy(save->glyph, glyph, sizeof(glyph));
+	save->preset_select = preset_select;
+	save->edit_mode = edit_mode;
+
+	journal_append(save->preset_select, save, sizeof(*save));
+	save_waited = 0;
 }
 
-void flash_read(void) {
+// defaults for a first run, into the current preset
+static void preset_defaults(void) {
 	u8 i1, i2;
 
-	print_dbg("\r\n read preset ");
-	print_dbg_ulong(preset_select);
-
+	// clear out some reasonable defaults
 	for(i1=0;i1<16;i1++) {
 		for(i2=0;i2<16;i2++) {
-			w.wp[i1].steps[i2] = flashy.w[preset_select].wp[i1].steps[i2];
-			w.wp[i1].step_probs[i2] = flashy.w[preset_select].wp[i1].step_probs[i2];
-			w.wp[i1].cv_probs[0][i2] = flashy.w[preset_select].wp[i1].cv_probs[0][i2];
-			w.wp[i1].cv_probs[1][i2] = flashy.w[preset_select].wp[i1].cv_probs[1][i2];
-			w.wp[i1].cv_curves[0][i2] = flashy.w[preset_select].wp[i1].cv_curves[0][i2];
-			w.wp[i1].cv_curves[1][i2] = flashy.w[preset_select].wp[i1].cv_curves[1][i2];
-			w.wp[i1].cv_steps[0][i2] = flashy.w[preset_select].wp[i1].cv_steps[0][i2];
-			w.wp[i1].cv_steps[1][i2] = flashy.w[preset_select].wp[i1].cv_steps[1][i2];
-			w.wp[i1].cv_values[i2] = flashy.w[preset_select].wp[i1].cv_values[i2];
+			w->wp[i1].steps[i2] = 0;
+			w->wp[i1].step_probs[i2] = 255;
+			w->wp[i1].cv_probs[0][i2] = 255;
+			w->wp[i1].cv_probs[1][i2] = 255;
+			w->wp[i1].cv_curves[0][i2] = 0;
+			w->wp[i1].cv_curves[1][i2] = 0;
+			w->wp[i1].cv_values[i2] = SCALES[2][i2];
+			w->wp[i1].cv_steps[0][i2] = 1<<i2;
+			w->wp[i1].cv_steps[1][i2] = 1<<i2;
 		}
-
-		w.wp[i1].step_choice = flashy.w[preset_select].wp[i1].step_choice;
-		w.wp[i1].loop_end = flashy.w[preset_select].wp[i1].loop_end;
-		w.wp[i1].loop_len = flashy.w[preset_select].wp[i1].loop_len;
-		w.wp[i1].loop_start = flashy.w[preset_select].wp[i1].loop_start;
-		w.wp[i1].loop_dir = flashy.w[preset_select].wp[i1].loop_dir;
-		w.wp[i1].step_mode = flashy.w[preset_select].wp[i1].step_mode;
-		w.wp[i1].ping_dir = flashy.w[preset_select].wp[i1].ping_dir;
-		w.wp[i1].cv_mode[0] = flashy.w[preset_select].wp[i1].cv_mode[0];
-		w.wp[i1].cv_mode[1] = flashy.w[preset_select].wp[i1].cv_mode[1];
-		w.wp[i1].tr_mode = flashy.w[preset_select].wp[i1].tr_mode;
+		w->wp[i1].step_choice = 0;
+		w->wp[i1].loop_end = 15;
+		w->wp[i1].loop_len = 15;
+		w->wp[i1].loop_start = 0;
+		w->wp[i1].loop_dir = 0;
+		w->wp[i1].step_mode = mForward;
+		w->wp[i1].ping_dir = mPingFwd;
+		w->wp[i1].cv_mode[0] = 0;
+		w->wp[i1].cv_mode[1] = 0;
+		w->wp[i1].tr_mode = 0;
 	}
 
-	w.series_start = flashy.w[preset_select].series_start;
-	w.series_end = flashy.w[preset_select].series_end;
+	w->series_start = 0;
+	w->series_end = 3;
 
-	w.tr_mute[0] = flashy.w[preset_select].tr_mute[0];
-	w.tr_mute[1] = flashy.w[preset_select].tr_mute[1];
-	w.tr_mute[2] = flashy.w[preset_select].tr_mute[2];
-	w.tr_mute[3] = flashy.w[preset_select].tr_mute[3];
-	w.cv_mute[0] = flashy.w[preset_select].cv_mute[0];
-	w.cv_mute[1] = flashy.w[preset_select].cv_mute[1];
+	w->tr_mute[0] = 1;
+	w->tr_mute[1] = 1;
+	w->tr_mute[2] = 1;
+	w->tr_mute[3] = 1;
+	w->cv_mute[0] = 1;
+	w->cv_mute[1] = 1;
 
 	for(i1=0;i1<64;i1++)
-		w.series_list[i1] = flashy.w[preset_select].series_list[i1];
+		w->series_list[i1] = 1;
+}
+
+// presets the journal has no record of: carried over from the old layout,
+// or defaults on a first run. written at once, before anything plays
+static void flash_fill(void) {
+	u8 i1, i2, fresh = flash_is_fresh();
+
+	for(i1=0;i1<8;i1++) {
+		if(journal_has(i1))
+			continue;
+
+		if(fresh) {
+			preset_defaults();
+			save->w = *w;
+			for(i2=0;i2<8;i2++)
+				save->glyph[i2] = i2 <= i1 ? 1<<i2 : 0;
+			save->preset_select = 0;
+			save->edit_mode = mTrig;
+		}
+		else {
+			save->w = flashy.w[i1];
+			memcpy(save->glyph, flashy.glyph[i1], sizeof(save->glyph));
+			save->preset_select = flashy.preset_select;
+			save->edit_mode = flashy.edit_mode;
+		}
+
+		journal_append(i1, save, sizeof(*save));
+		journal_flush();
+	}
+}
+
+// show a preset's glyph while choosing on the preset screen
+static void glyph_load(u8 preset) {
+	journal_read(preset, glyph, offsetof(preset_record, glyph), sizeof(glyph));
+}
+
+// fetch a preset into the spare set, then switch to it now or leave that
+// to clock() on the next pattern boundary
+void flash_read(u8 preset, preset_switch when) {
+	irqflags_t flags;
+	u32 t;
+
+	// a save still being written is read from its buffer
+	if(!journal_has(preset))
+		return;
+
+	print_dbg("\r\n read preset ");
+	print_dbg_ulong(preset);
+
+	// drop any switch still waiting, so clock() can't take the spare while
+	// it is written, and any step resolved ahead from it
+	preset_next = PRESET_NONE;
+	step_invalidate();
+
+	// one block copy: the record is laid out as a set is
+	t = Get_sys_count();
+	journal_read(preset, &sets[w == &sets[0]], offsetof(preset_record, w), sizeof(whale_set));
+	latency_add(&lat_load, Get_sys_count() - t);
+
+	// the set is whole before clock() can see it waiting
+	__asm__ __volatile__("" ::: "memory");
+	preset_next = preset;
+
+	// clock() must not run between the swap and the reseed
+	if(when == switchNow) {
+		flags = cpu_irq_save();
+		preset_swap();
+		step_invalidate();
+		cpu_irq_restore(flags);
+	}
+}
+
+void flash_print_stats(void) {
+	latency_print(&lat_load);
 }
 
 
@@ -2030,7 +2592,7 @@ void flash_read(void) {
 
 int main(void)
 {
-	u8 i1,i2;
+	u8 latest;
 
 	sysclk_init();
 
@@ -2041,6 +2603,8 @@ int main(void)
 	init_events();
 	init_tc();
 	init_spi();
+	init_dac();
+	init_gate();
 	init_adc();
 
 	irq_initialize_vectors();
@@ -2054,88 +2618,44 @@ int main(void)
 
 
 	print_dbg("\r\n\n// white whale //////////////////////////////// ");
-	print_dbg_ulong(sizeof(flashy));
+	print_dbg_ulong(sizeof(journal_flash));
 
 	print_dbg(" ");
-	print_dbg_ulong(sizeof(w));
+	print_dbg_ulong(sizeof(*w));
 
 	print_dbg(" ");
 	print_dbg_ulong(sizeof(glyph));
 
-	if(flash_is_fresh()) {
-		print_dbg("\r\nfirst run.");
-		flash_unfresh();
-		flashc_memset8((void*)&(flashy.edit_mode), mTrig, 4, true);
-		flashc_memset32((void*)&(flashy.preset_select), 0, 4, true);
+	random_seed(&rnd_edit, 0x200);
 
+	journal_init();
+	journal_print_stats();
+	if(journal_latest() == JOURNAL_NONE && flash_is_fresh())
+		print_dbg("\r\nfirst run.");
+	flash_fill();
 
-		// clear out some reasonable defaults
-		for(i1=0;i1<16;i1++) {
-			for(i2=0;i2<16;i2++) {
-				w.wp[i1].steps[i2] = 0;
-				w.wp[i1].step_probs[i2] = 255;
-				w.wp[i1].cv_probs[0][i2] = 255;
-				w.wp[i1].cv_probs[1][i2] = 255;
-				w.wp[i1].cv_curves[0][i2] = 0;
-				w.wp[i1].cv_curves[1][i2] = 0;
-				w.wp[i1].cv_values[i2] = SCALES[2][i2];
-				w.wp[i1].cv_steps[0][i2] = 1<<i2;
-				w.wp[i1].cv_steps[1][i2] = 1<<i2;
-			}
-			w.wp[i1].step_choice = 0;
-			w.wp[i1].loop_end = 15;
-			w.wp[i1].loop_len = 15;
-			w.wp[i1].loop_start = 0;
-			w.wp[i1].loop_dir = 0;
-			w.wp[i1].step_mode = mForward;
-			w.wp[i1].ping_dir = mPingFwd;
-			w.wp[i1].cv_mode[0] = 0;
-			w.wp[i1].cv_mode[1] = 0;
-			w.wp[i1].tr_mode = 0;
-		}
-
-		w.series_start = 0;
-		w.series_end = 3;
-
-		w.tr_mute[0] = 1;
-		w.tr_mute[1] = 1;
-		w.tr_mute[2] = 1;
-		w.tr_mute[3] = 1;
-		w.cv_mute[0] = 1;
-		w.cv_mute[1] = 1;
-
-		for(i1=0;i1<64;i1++)
-			w.series_list[i1] = 1;
-
-		// save all presets, clear glyphs
-		for(i1=0;i1<8;i1++) {
-			flashc_memcpy((void *)&flashy.w[i1], &w, sizeof(w), true);
-			glyph[i1] = (1<<i1);
-			flashc_memcpy((void *)&flashy.glyph[i1], &glyph, sizeof(glyph), true);
-		}
-	}
-	else {
-		// load from flash at startup
-		preset_select = flashy.preset_select;
-		edit_mode = flashy.edit_mode;
-		flash_read();
-		for(i1=0;i1<8;i1++)
-			glyph[i1] = flashy.glyph[preset_select][i1];
-	}
+	// load the preset saved last, on the screen it was saved from
+	latest = journal_latest();
+	journal_read(latest, save, 0, sizeof(*save));
+	edit_mode = save->edit_mode;
+	flash_read(save->preset_select, switchNow);
+	glyph_load(preset_select);
 
 	LENGTH = 15;
 	SIZE = 16;
 
-	re = &refresh;
+	pal = &palette_vari;
+	lay = &layout16;
 
 	process_ii = &ww_process_ii;
 
 	clock_pulse = &clock;
 	clock_external = !gpio_get_pin_value(B09);
 
-	timer_add(&clockTimer,120,&clockTimer_callback, NULL);
-	timer_add(&keyTimer,50,&keyTimer_callback, NULL);
+	init_tempo(&tempo_callback, 120000);
 	timer_add(&adcTimer,100,&adcTimer_callback, NULL);
+	// tidy the journal in idle time from the start
+	save_tick();
 	clock_temp = 10000; // out of ADC range to force tempo
 
 	// setup daisy chain for two dacs
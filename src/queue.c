@@ -0,0 +1,236 @@
+// prioritised event dispatch.
+//
+// libavr32 posts every event into one fifo, so a burst of keys, refreshes
+// and adc polls used to hold up a clock edge behind it. each pass of the
+// main loop now moves whatever has arrived into one of three levels and
+// runs the oldest event of the most urgent level. the idle level holds at
+// most one event per type: a refresh or adc poll posted while one is
+// still waiting is folded into it, keeping the newest data.
+//
+// the app's own interrupts post into a lock-free ring per source rather
+// than into the libavr32 fifo, so they don't mask interrupts to post and
+// a full ring is counted per event type instead of losing events
+// silently. the main loop posts straight into the levels.
+//
+// waits are timed from when the main loop first sees an event, so time
+// spent in a fifo or ring behind a long handler isn't counted.
+
+#include "compiler.h"
+#include "cycle_counter.h"
+#include "print_funcs.h"
+
+#include "latency.h"
+#include "queue.h"
+
+// keep the event stores ahead of publishing the index
+#define QUEUE_BARRIER() __asm__ __volatile__("" ::: "memory")
+
+typedef struct {
+	event_t e;
+	u32 at;
+} queued_t;
+
+typedef struct {
+	u8 put, get, count, max;
+	u8 depth_max;
+	u32 posted, dropped, coalesced;
+	latency_t wait;
+} level_t;
+
+static queued_t clock_ring[QUEUE_CLOCK_MAX];
+static queued_t input_ring[QUEUE_INPUT_MAX];
+static queued_t *const rings[queueIdle] = { clock_ring, input_ring };
+
+// idle level: types in posting order, and each type's latest event
+static u8 idle_ring[kNumEventTypes];
+static u8 idle_waiting[kNumEventTypes];
+static queued_t idle_event[kNumEventTypes];
+
+static level_t levels[queueLevels] = {
+	{ .max = QUEUE_CLOCK_MAX, .wait = { "queue clock wait" } },
+	{ .max = QUEUE_INPUT_MAX, .wait = { "queue input wait" } },
+	{ .max = kNumEventTypes, .wait = { "queue idle wait" } }
+};
+
+queue_ring queue_timer = { "timer" };
+queue_ring queue_ii = { "ii" };
+static queue_ring *const ring_list[] = { &queue_timer, &queue_ii };
+#define RINGS (sizeof(ring_list) / sizeof(ring_list[0]))
+
+
+static queue_level level_of(etype t) {
+	switch(t) {
+	case kEventClockExt:
+	case kEventClockNormal:
+	case kEventII:
+		return queueClock;
+	case kEventMonomeRefresh:
+	case kEventPollADC:
+	case kEventScreenRefresh:
+	case kEventMidiRefresh:
+		return queueIdle;
+	default:
+		return queueInput;
+	}
+}
+
+static void put(const event_t *e, u32 now) {
+	queue_level i = level_of(e->type);
+	level_t *l = &levels[i];
+
+	l->posted++;
+
+	if(i == queueIdle && idle_waiting[e->type]) {
+		idle_event[e->type].e.data = e->data;
+		l->coalesced++;
+		return;
+	}
+	if(l->count == l->max) {
+		l->dropped++;
+		return;
+	}
+
+	if(i == queueIdle) {
+		idle_waiting[e->type] = 1;
+		idle_event[e->type].e = *e;
+		idle_event[e->type].at = now;
+		idle_ring[l->put] = e->type;
+	}
+	else {
+		rings[i][l->put].e = *e;
+		rings[i][l->put].at = now;
+	}
+
+	l->put = (l->put + 1) % l->max;
+	if(++l->count > l->depth_max)
+		l->depth_max = l->count;
+}
+
+// from the ring's own interrupt only
+u8 queue_ring_post(queue_ring *r, etype type, s32 data) {
+	u8 p = r->put;
+	u8 n = p - r->get;
+
+	if(n == QUEUE_RING_SIZE) {
+		r->dropped[type]++;
+		return 0;
+	}
+	if(n >= r->high)
+		r->high = n + 1;
+
+	r->e[p % QUEUE_RING_SIZE].type = type;
+	r->e[p % QUEUE_RING_SIZE].data = data;
+	QUEUE_BARRIER();
+	r->put = p + 1;
+	return 1;
+}
+
+// from the main loop
+void queue_post(etype type, s32 data) {
+	event_t e;
+
+	e.type = type;
+	e.data = data;
+	put(&e, Get_sys_count());
+}
+
+// take in everything libavr32 and the rings hold, then hand out the most
+// urgent
+u8 queue_next(event_t *e) {
+	event_t in;
+	queued_t *q;
+	queue_ring *r;
+	level_t *l;
+	u8 i, g;
+
+	while(event_next(&in))
+		put(&in, Get_sys_count());
+
+	for(i=0;i<RINGS;i++) {
+		r = ring_list[i];
+		for(g = r->get; g != r->put; g++)
+			put(&r->e[g % QUEUE_RING_SIZE], Get_sys_count());
+		QUEUE_BARRIER();
+		r->get = g;
+	}
+
+	for(i=0;i<queueLevels;i++) {
+		l = &levels[i];
+		if(l->count == 0)
+			continue;
+
+		if(i == queueIdle) {
+			q = &idle_event[idle_ring[l->get]];
+			idle_waiting[q->e.type] = 0;
+		}
+		else
+			q = &rings[i][l->get];
+
+		l->get = (l->get + 1) % l->max;
+		l->count--;
+
+		*e = q->e;
+		latency_add(&l->wait, Get_sys_count() - q->at);
+		return 1;
+	}
+
+	return 0;
+}
+
+u8 queue_pending(void) {
+	u8 i;
+
+	for(i=0;i<queueLevels;i++)
+		if(levels[i].count)
+			return 1;
+	for(i=0;i<RINGS;i++)
+		if(ring_list[i]->put != ring_list[i]->get)
+			return 1;
+	return 0;
+}
+
+void queue_print_stats(void) {
+	queue_ring *r;
+	level_t *l;
+	u8 i, t, any;
+
+	for(i=0;i<queueLevels;i++) {
+		l = &levels[i];
+		latency_print(&l->wait);
+		print_dbg(" posted ");
+		print_dbg_ulong(l->posted);
+		print_dbg(" depth max ");
+		print_dbg_ulong(l->depth_max);
+		print_dbg(" dropped ");
+		print_dbg_ulong(l->dropped);
+		print_dbg(" coalesced ");
+		print_dbg_ulong(l->coalesced);
+
+		l->posted = l->dropped = l->coalesced = 0;
+		l->depth_max = l->count;
+	}
+
+	for(i=0;i<RINGS;i++) {
+		r = ring_list[i];
+		print_dbg("\r\nring ");
+		print_dbg(r->name);
+		print_dbg(" high ");
+		print_dbg_ulong(r->high);
+		print_dbg(" dropped");
+		any = 0;
+		for(t=0;t<kNumEventTypes;t++) {
+			if(r->dropped[t]) {
+				any = 1;
+				print_dbg(" type ");
+				print_dbg_ulong(t);
+				print_dbg(": ");
+				print_dbg_ulong(r->dropped[t]);
+				r->dropped[t] = 0;
+			}
+		}
+		if(!any)
+			print_dbg(" 0");
+		// the interrupt may raise it again meanwhile, that's fine
+		r->high = 0;
+	}
+}
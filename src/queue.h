@@ -0,0 +1,40 @@
+#ifndef _QUEUE_H_
+#define _QUEUE_H_
+
+#include "types.h"
+#include "events.h"
+
+// dispatch order, most urgent first
+typedef enum {
+	queueClock,		// clock edges and ii
+	queueInput,		// keys, buttons, flash and everything unlisted
+	queueIdle,		// refresh and adc polls, coalesced per type
+	queueLevels
+} queue_level;
+
+#define QUEUE_CLOCK_MAX 16
+#define QUEUE_INPUT_MAX 32
+
+// events from one interrupt source: only that interrupt writes put and
+// only the main loop writes get, so neither side masks interrupts.
+// the size must divide 256 for the free running indices
+#define QUEUE_RING_SIZE 16
+
+typedef struct {
+	const char *name;
+	volatile u8 put, get;
+	u8 high;
+	event_t e[QUEUE_RING_SIZE];
+	u16 dropped[kNumEventTypes];
+} queue_ring;
+
+// soft timer callbacks, and ii commands from the twi slave interrupt
+extern queue_ring queue_timer, queue_ii;
+
+extern u8 queue_ring_post(queue_ring *r, etype type, s32 data);
+extern void queue_post(etype type, s32 data);
+extern u8 queue_next(event_t *e);
+extern u8 queue_pending(void);
+extern void queue_print_stats(void);
+
+#endif
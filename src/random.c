@@ -0,0 +1,16 @@
+// seeding for the xorshift streams in random.h.
+//
+// seeds are scrambled so neighbouring seeds (pattern 0, 1, 2...) start
+// uncorrelated, and zero, which xorshift can never leave, is avoided.
+
+#include "random.h"
+
+void random_seed(random_t *r, u32 seed) {
+	u32 x = seed + 0x9e3779b9;
+
+	x = (x ^ (x >> 16)) * 0x85ebca6b;
+	x = (x ^ (x >> 13)) * 0xc2b2ae35;
+	x ^= x >> 16;
+
+	r->x = x ? x : 0x9e3779b9;
+}
@@ -0,0 +1,41 @@
+#ifndef _RANDOM_H_
+#define _RANDOM_H_
+
+#include "types.h"
+
+// xorshift generator, one state per independent stream
+typedef struct {
+	u32 x;
+} random_t;
+
+extern void random_seed(random_t *r, u32 seed);
+
+static inline u32 random_next(random_t *r) {
+	u32 x = r->x;
+
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	return r->x = x;
+}
+
+// uniform in 0..n-1 (n > 0). the high word of next * n picks the value
+// with one multiply; draws landing in the short leftover band are redrawn
+// so every value is equally likely. the division only runs when the low
+// word falls below n, which for the small ranges used here is rare.
+static inline u32 random_range(random_t *r, u32 n) {
+	u64 m = (u64)random_next(r) * n;
+	u32 l = (u32)m;
+
+	if(l < n) {
+		u32 t = -n % n;
+		while(l < t) {
+			m = (u64)random_next(r) * n;
+			l = (u32)m;
+		}
+	}
+
+	return m >> 32;
+}
+
+#endif
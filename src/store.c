@@ -0,0 +1,124 @@
+// chunked flash writer.
+//
+// a job is a list of ram to flash copies. each call to store_page()
+// programs the part of the next copy that falls in one flash page, so the
+// caller decides when the cpu can afford to stall on a page write. the
+// source must stay put until the job is done: callers stage it, and
+// finish a job with store_flush() before staging over its sources.
+//
+// every part is programmed: callers pass only what needs writing. the
+// journal, writing to freshly erased records, leaves out the pages a save
+// didn't change.
+
+#include "compiler.h"
+#include "cycle_counter.h"
+#include "flashc.h"
+#include "print_funcs.h"
+
+#include "conf_board.h"
+#include "store.h"
+
+typedef struct {
+	volatile u8 *dst;
+	const u8 *src;
+	u32 bytes;
+} segment_t;
+
+u32 store_pages;
+
+static segment_t segments[STORE_SEGMENTS];
+static u8 count, next, erase;
+static u32 pages;
+// page last programmed, so copies sharing a page count it once
+static size_t last_page;
+
+// cycles for one page, most seen
+static u32 page_cy, page_max;
+
+
+// bytes of the next copy that fall in one page
+static u32 chunk(const segment_t *s) {
+	u32 n = STORE_PAGE - ((size_t)s->dst & (STORE_PAGE - 1));
+
+	return n > s->bytes ? s->bytes : n;
+}
+
+static void advance(segment_t *s, u32 n) {
+	s->dst += n;
+	s->src += n;
+	s->bytes -= n;
+	if(s->bytes == 0)
+		next++;
+}
+
+// start a new job, finishing any still in progress rather than losing
+// it. without erase, the pages must have been erased already
+void store_begin(u8 e) {
+	store_flush();
+	erase = e;
+	count = next = 0;
+	pages = 0;
+	last_page = 0;
+}
+
+void store_add(volatile void *dst, const void *src, u32 bytes) {
+	if(count == STORE_SEGMENTS)
+		return;
+	segments[count].dst = dst;
+	segments[count].src = src;
+	segments[count].bytes = bytes;
+	count++;
+}
+
+u8 store_busy(void) {
+	return next < count;
+}
+
+// program the next page, returning the cycles it took
+u32 store_page(void) {
+	segment_t *s;
+	size_t page;
+	u32 n, t;
+
+	if(next == count)
+		return 0;
+
+	s = &segments[next];
+	n = chunk(s);
+
+	t = Get_sys_count();
+	flashc_memcpy(s->dst, s->src, n, erase);
+	t = Get_sys_count() - t;
+
+	page = (size_t)s->dst & ~(size_t)(STORE_PAGE - 1);
+	if(page != last_page)
+		pages++;
+	last_page = page;
+
+	advance(s, n);
+	if(next == count)
+		store_pages = pages;
+
+	page_cy = t;
+	if(t > page_max)
+		page_max = t;
+
+	return t;
+}
+
+// finish the job now, stalling for as long as it takes
+void store_flush(void) {
+	while(store_busy())
+		store_page();
+}
+
+void store_print_stats(void) {
+	print_dbg("\r\nflash pages last save ");
+	print_dbg_ulong(store_pages);
+	print_dbg(" page us ");
+	print_dbg_ulong(cpu_cy_2_us(page_cy, FMCK_HZ));
+	print_dbg(" max ");
+	print_dbg_ulong(cpu_cy_2_us(page_max, FMCK_HZ));
+
+	page_max = 0;
+}
@@ -0,0 +1,22 @@
+#ifndef _STORE_H_
+#define _STORE_H_
+
+#include "types.h"
+
+// flash page on the uc3b, AVR32_FLASHC_PAGE_SIZE
+#define STORE_PAGE 512
+// copies in a job: a journal record's worst case is every other page,
+// and its header
+#define STORE_SEGMENTS 5
+
+// distinct pages programmed by the last completed job
+extern u32 store_pages;
+
+extern void store_begin(u8 erase);
+extern void store_add(volatile void *dst, const void *src, u32 bytes);
+extern u8 store_busy(void);
+extern u32 store_page(void);
+extern void store_flush(void);
+extern void store_print_stats(void);
+
+#endif
@@ -0,0 +1,130 @@
+// internal clock.
+//
+// edges are scheduled on a one-shot tc from a phase accumulator holding
+// the next edge time in cycle counter units with 16 fractional bits, so
+// the clock neither drifts nor rounds the period to whole ticks. a new
+// tempo only changes the interval after the edge already scheduled, so
+// turning the pot never restarts or skips a phase.
+
+#include "compiler.h"
+#include "cycle_counter.h"
+#include "intc.h"
+#include "tc.h"
+
+#include "conf_board.h"
+#include "tempo.h"
+
+// tc clocked at pba/32, pba runs at the cpu clock: one tick is 32 cycles
+#define TEMPO_TC_DIV 32
+#define TEMPO_TC_MAX 0xffff
+
+static tempo_callback_t callback;
+
+// next edge and half period, cycles << 16
+static u64 phase;
+static volatile u64 half;
+// when the edge being handled was due, cycles
+static u32 edge_at;
+
+
+static void tempo_arm(u32 now) {
+	s32 d = (u32)(phase >> 16) - now;
+
+	d /= TEMPO_TC_DIV;
+	if(d < 1)
+		d = 1;
+	else if(d > TEMPO_TC_MAX)
+		d = TEMPO_TC_MAX;
+
+	tc_write_rc(TEMPO_TC, TEMPO_TC_CHANNEL, d);
+	tc_start(TEMPO_TC, TEMPO_TC_CHANNEL);
+}
+
+__attribute__((__interrupt__))
+static void irq_tempo(void) {
+	u32 now;
+
+	tc_read_sr(TEMPO_TC, TEMPO_TC_CHANNEL);
+	now = Get_sys_count();
+
+	// long periods take several tc rounds
+	if((s32)((u32)(phase >> 16) - now) > 0) {
+		tempo_arm(now);
+		return;
+	}
+
+	edge_at = phase >> 16;
+	phase += half;
+	tempo_arm(now);
+
+	(*callback)();
+}
+
+u32 tempo_edge_at(void) {
+	return edge_at;
+}
+
+void init_tempo(tempo_callback_t edge, u32 half_us) {
+	static const tc_waveform_opt_t opt = {
+		.channel = TEMPO_TC_CHANNEL,
+		.bswtrg = TC_EVT_EFFECT_NOOP,
+		.beevt = TC_EVT_EFFECT_NOOP,
+		.bcpc = TC_EVT_EFFECT_NOOP,
+		.bcpb = TC_EVT_EFFECT_NOOP,
+		.aswtrg = TC_EVT_EFFECT_NOOP,
+		.aeevt = TC_EVT_EFFECT_NOOP,
+		.acpc = TC_EVT_EFFECT_NOOP,
+		.acpa = TC_EVT_EFFECT_NOOP,
+		.wavsel = TC_WAVEFORM_SEL_UP_MODE_RC_TRIGGER,
+		.enetrg = false,
+		.eevt = 0,
+		.eevtedg = TC_SEL_NO_EDGE,
+		.cpcdis = true,		// one-shot: stop on rc compare
+		.cpcstop = false,
+		.burst = false,
+		.clki = false,
+		.tcclks = TC_CLOCK_SOURCE_TC4
+	};
+	static const tc_interrupt_t irq = { .cpcs = 1 };
+
+	callback = edge;
+	half = (u64)cpu_us_2_cy(half_us, FMCK_HZ) << 16;
+
+	INTC_register_interrupt(&irq_tempo, TEMPO_TC_IRQ, AVR32_INTC_INT3);
+	tc_init_waveform(TEMPO_TC, &opt);
+	tc_configure_interrupts(TEMPO_TC, TEMPO_TC_CHANNEL, &irq);
+
+	tempo_sync();
+}
+
+// half period in cycles << 16, used from the next edge on
+void tempo_set(u64 h) {
+	irqflags_t flags = cpu_irq_save();
+	half = h;
+	cpu_irq_restore(flags);
+}
+
+// restart the phase: the next edge comes one half period from now
+void tempo_sync(void) {
+	u32 now;
+	irqflags_t flags = cpu_irq_save();
+
+	now = Get_sys_count();
+	phase = ((u64)now << 16) + half;
+	tempo_arm(now);
+
+	cpu_irq_restore(flags);
+}
+
+// clock pulses per minute, in tenths
+u32 tempo_bpm10(void) {
+	u64 h;
+	irqflags_t flags = cpu_irq_save();
+
+	h = half;
+	cpu_irq_restore(flags);
+
+	if(h == 0)
+		return 0;
+	return ((u64)FMCK_HZ * 600 << 16) / (h * 2);
+}
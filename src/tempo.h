@@ -0,0 +1,19 @@
+#ifndef _TEMPO_H_
+#define _TEMPO_H_
+
+#include "types.h"
+
+// tc channel dedicated to the internal clock
+#define TEMPO_TC (&AVR32_TC)
+#define TEMPO_TC_CHANNEL 2
+#define TEMPO_TC_IRQ AVR32_TC_IRQ2
+
+typedef void (*tempo_callback_t)(void);
+
+extern void init_tempo(tempo_callback_t edge, u32 half_us);
+extern void tempo_set(u64 half_q16);
+extern void tempo_sync(void);
+extern u32 tempo_bpm10(void);
+extern u32 tempo_edge_at(void);
+
+#endif